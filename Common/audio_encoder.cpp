@@ -0,0 +1,585 @@
+// audio_encoder.cpp : Collects converted samples into encoder frames or PCM packets and muxes them into the destination sink.
+//
+
+#include "audio_encoder.h"
+
+#include <cstring>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/intreadwrite.h>
+#include <libavutil/mem.h>
+}
+
+// Samples per frame for encoders that take any count (G.722, G.726).
+#define AUDIO_ENCODER_FRAME 1024
+// Samples per packet of PCM, which has no frames of its own.
+#define AUDIO_ENCODER_PCM_FRAMES 8192
+#define AUDIO_ENCODER_IO_SIZE 65536
+
+typedef struct AUDIO_CODEC_INFO {
+    const char* name;
+    enum AVCodecID id;
+    const char* muxer;
+    const char* rawMuxer;       // NULL when the codec has no stream format of its own
+    const char* extension;
+} AudioCodecInfo;
+
+// Indexed by enum AudioCodec.
+static const AudioCodecInfo codec_info[] = {
+    { "pcm",       AV_CODEC_ID_NONE,          "wav",  NULL,   ".wav" },
+    { "flac",      AV_CODEC_ID_FLAC,          "flac", "flac", ".flac" },
+    { "adpcm_ima", AV_CODEC_ID_ADPCM_IMA_WAV, "wav",  NULL,   ".wav" },
+    { "adpcm_ms",  AV_CODEC_ID_ADPCM_MS,      "wav",  NULL,   ".wav" },
+    { "g722",      AV_CODEC_ID_ADPCM_G722,    "wav",  "g722", ".wav" },
+    { "g726",      AV_CODEC_ID_ADPCM_G726,    "wav",  "g726", ".wav" },
+};
+
+typedef struct AUDIO_CONTAINER_INFO {
+    const char* name;
+    const char* muxer;          // NULL for raw, which depends on the codec
+    const char* extension;
+    int bigEndian;
+} AudioContainerInfo;
+
+// Indexed by enum AudioContainer.
+static const AudioContainerInfo container_info[] = {
+    { "default", NULL,       NULL,   0 },
+    { "wav",     "wav",      ".wav", 0 },
+    { "au",      "au",       ".au",  1 },
+    { "caf",     "caf",      ".caf", 0 },
+    { "raw",     NULL,       ".raw", 0 },
+    { "mkv",     "matroska", ".mka", 0 },
+};
+
+struct AUDIO_ENCODER {
+    // NULL for PCM, which is packetized as it is.
+    AVCodecContext* ctx;
+    enum AVCodecID pcmId;
+    AVFormatContext* mux;
+    AVFrame* frame;
+    AVPacket* pkt;
+
+    // Converted samples, packed as they arrive, until a whole frame is there.
+    uint8_t* pending;
+    int pendingSize;
+    int frameBytes;
+    int blockAlign;
+    int channels;
+    AVRational timeBase;
+    int64_t nextPts;
+
+    OutputSink input;
+
+    // Muxer output. ioPos is the AVIO position, counted from destBase, the
+    // position dest had when the encoder was opened.
+    OutputSink* dest;
+    int64_t destBase;
+    int64_t ioPos;
+};
+
+int audio_codec_parse(const char* name, enum AudioCodec* codec)
+{
+    for (size_t i = 0; i < sizeof(codec_info) / sizeof(codec_info[0]); i++) {
+        if (!strcmp(name, codec_info[i].name)) {
+            *codec = (enum AudioCodec)i;
+            return 0;
+        }
+    }
+
+    fprintf(stderr, "Unknown codec '%s'\n", name);
+    return AVERROR(EINVAL);
+}
+
+int audio_container_parse(const char* name, enum AudioContainer* container)
+{
+    for (size_t i = AUDIO_CONTAINER_WAV; i < sizeof(container_info) / sizeof(container_info[0]); i++) {
+        if (!strcmp(name, container_info[i].name)) {
+            *container = (enum AudioContainer)i;
+            return 0;
+        }
+    }
+
+    fprintf(stderr, "Unknown container '%s'\n", name);
+    return AVERROR(EINVAL);
+}
+
+int audio_encoder_needed(enum AudioCodec codec, enum AudioContainer container)
+{
+    return codec != AUDIO_CODEC_PCM || container != AUDIO_CONTAINER_DEFAULT;
+}
+
+enum AVSampleFormat audio_codec_sample_fmt(enum AudioCodec codec, enum AVSampleFormat requested)
+{
+    if (codec == AUDIO_CODEC_PCM || (codec == AUDIO_CODEC_FLAC && requested == AV_SAMPLE_FMT_S32))
+        return requested;
+    return AV_SAMPLE_FMT_S16;
+}
+
+int audio_codec_sample_rate(enum AudioCodec codec, int requested)
+{
+    return codec == AUDIO_CODEC_G722 ? 16000 : requested;
+}
+
+const char* audio_encoder_extension(enum AudioCodec codec, enum AudioContainer container)
+{
+    return container == AUDIO_CONTAINER_DEFAULT ? codec_info[codec].extension : container_info[container].extension;
+}
+
+// Codec of the samples as the conversion delivers them, in the byte order
+// the container wants.
+static enum AVCodecID pcm_codec_id(const OutputFormat* format, int big_endian)
+{
+    if (format->law == G711_ULAW)
+        return AV_CODEC_ID_PCM_MULAW;
+    if (format->law == G711_ALAW)
+        return AV_CODEC_ID_PCM_ALAW;
+
+    switch (format->sampleFmt) {
+    case AV_SAMPLE_FMT_U8:  return big_endian ? AV_CODEC_ID_PCM_S8 : AV_CODEC_ID_PCM_U8;
+    case AV_SAMPLE_FMT_S16: return big_endian ? AV_CODEC_ID_PCM_S16BE : AV_CODEC_ID_PCM_S16LE;
+    case AV_SAMPLE_FMT_S32: return big_endian ? AV_CODEC_ID_PCM_S32BE : AV_CODEC_ID_PCM_S32LE;
+    case AV_SAMPLE_FMT_FLT: return big_endian ? AV_CODEC_ID_PCM_F32BE : AV_CODEC_ID_PCM_F32LE;
+    default:
+        return AV_CODEC_ID_NONE;
+    }
+}
+
+static const char* pcm_raw_muxer(enum AVCodecID id)
+{
+    switch (id) {
+    case AV_CODEC_ID_PCM_U8:    return "u8";
+    case AV_CODEC_ID_PCM_S16LE: return "s16le";
+    case AV_CODEC_ID_PCM_S32LE: return "s32le";
+    case AV_CODEC_ID_PCM_F32LE: return "f32le";
+    case AV_CODEC_ID_PCM_MULAW: return "mulaw";
+    case AV_CODEC_ID_PCM_ALAW:  return "alaw";
+    default:
+        return NULL;
+    }
+}
+
+static const char* muxer_name(enum AudioCodec codec, enum AudioContainer container, enum AVCodecID pcm_id)
+{
+    if (container == AUDIO_CONTAINER_DEFAULT)
+        return codec_info[codec].muxer;
+    if (container == AUDIO_CONTAINER_RAW)
+        return codec == AUDIO_CODEC_PCM ? pcm_raw_muxer(pcm_id) : codec_info[codec].rawMuxer;
+    return container_info[container].muxer;
+}
+
+// Copies bytes of converted samples, native order, into a packet of codec id.
+static void copy_pcm(enum AVCodecID id, uint8_t* dst, const uint8_t* src, int bytes)
+{
+    switch (id) {
+    case AV_CODEC_ID_PCM_S8:
+        for (int i = 0; i < bytes; i++)
+            dst[i] = src[i] ^ 0x80;
+        break;
+    case AV_CODEC_ID_PCM_S16BE:
+        for (int i = 0; i < bytes; i += 2)
+            AV_WB16(dst + i, AV_RN16(src + i));
+        break;
+    case AV_CODEC_ID_PCM_S32BE:
+    case AV_CODEC_ID_PCM_F32BE:
+        for (int i = 0; i < bytes; i += 4)
+            AV_WB32(dst + i, AV_RN32(src + i));
+        break;
+    default:
+        memcpy(dst, src, bytes);
+    }
+}
+
+// AVIO write callback. Muxers only go back to patch sizes into bytes that are
+// already out, everything else is appended.
+static int io_write(void* opaque, uint8_t* buf, int size)
+{
+    AudioEncoder* enc = (AudioEncoder*)opaque;
+    int64_t end = enc->dest->pos - enc->destBase;
+    int written = size;
+
+    if (enc->ioPos < end) {
+        int head = (int)FFMIN((int64_t)size, end - enc->ioPos);
+        if (output_sink_write_at(enc->dest, enc->destBase + enc->ioPos, buf, head) != head)
+            return AVERROR(EIO);
+        enc->ioPos += head;
+        buf += head;
+        size -= head;
+    }
+    if (size > 0) {
+        if (enc->ioPos != end)
+            return AVERROR(EINVAL);
+        int ret = output_sink_write(enc->dest, buf, size);
+        if (ret < 0)
+            return ret;
+        enc->ioPos += size;
+    }
+
+    return written;
+}
+
+static int64_t io_seek(void* opaque, int64_t offset, int whence)
+{
+    AudioEncoder* enc = (AudioEncoder*)opaque;
+    int64_t end = enc->dest->pos - enc->destBase;
+    int64_t pos;
+
+    switch (whence & ~AVSEEK_FORCE) {
+    case AVSEEK_SIZE: return end;
+    case SEEK_SET:    pos = offset; break;
+    case SEEK_CUR:    pos = enc->ioPos + offset; break;
+    case SEEK_END:    pos = end + offset; break;
+    default:
+        return AVERROR(EINVAL);
+    }
+
+    if (pos < 0 || pos > end)
+        return AVERROR(EINVAL);
+    enc->ioPos = pos;
+    return pos;
+}
+
+// Muxes pkt, timed in samples, and takes over its reference.
+static int write_packet(AudioEncoder* enc)
+{
+    AVStream* stream = enc->mux->streams[0];
+
+    av_packet_rescale_ts(enc->pkt, enc->timeBase, stream->time_base);
+    enc->pkt->stream_index = stream->index;
+
+    int ret = av_interleaved_write_frame(enc->mux, enc->pkt);
+    if (ret < 0)
+        fprintf(stderr, "Error writing a packet to the %s muxer\n", enc->mux->oformat->name);
+    return ret;
+}
+
+// Sends frame, NULL to drain, and muxes every packet the encoder has ready.
+static int encode_frame(AudioEncoder* enc, const AVFrame* frame)
+{
+    int ret = avcodec_send_frame(enc->ctx, frame);
+
+    if (ret < 0) {
+        fprintf(stderr, "Error sending a frame to the encoder\n");
+        return ret;
+    }
+
+    while ((ret = avcodec_receive_packet(enc->ctx, enc->pkt)) >= 0) {
+        ret = write_packet(enc);
+        if (ret < 0)
+            return ret;
+    }
+
+    return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF ? 0 : ret;
+}
+
+template <typename T>
+static void deinterleave(uint8_t** planes, const uint8_t* src, int channels, int nb_samples)
+{
+    const T* in = (const T*)src;
+
+    for (int c = 0; c < channels; c++) {
+        T* out = (T*)planes[c];
+        for (int i = 0; i < nb_samples; i++)
+            out[i] = in[i * channels + c];
+    }
+}
+
+static int encode_samples(AudioEncoder* enc, int nb_samples)
+{
+    AVFrame* frame = enc->frame;
+
+    // The encoder may still hold a reference to the previous frame.
+    int ret = av_frame_make_writable(frame);
+    if (ret < 0)
+        return ret;
+
+    frame->nb_samples = nb_samples;
+    frame->pts = enc->nextPts;
+
+    if (!av_sample_fmt_is_planar(enc->ctx->sample_fmt))
+        memcpy(frame->data[0], enc->pending, (size_t)nb_samples * enc->blockAlign);
+    else if (av_get_bytes_per_sample(enc->ctx->sample_fmt) == 2)
+        deinterleave<int16_t>(frame->extended_data, enc->pending, enc->channels, nb_samples);
+    else
+        deinterleave<int32_t>(frame->extended_data, enc->pending, enc->channels, nb_samples);
+
+    return encode_frame(enc, frame);
+}
+
+static int write_samples(AudioEncoder* enc, int nb_samples)
+{
+    int bytes = nb_samples * enc->blockAlign;
+    int ret = av_new_packet(enc->pkt, bytes);
+    if (ret < 0)
+        return ret;
+
+    copy_pcm(enc->pcmId, enc->pkt->data, enc->pending, bytes);
+    enc->pkt->pts = enc->pkt->dts = enc->nextPts;
+    enc->pkt->duration = nb_samples;
+
+    return write_packet(enc);
+}
+
+// Encodes or packetizes the whole sample frames in pending, which holds at
+// most one frame; a split sample frame at the end stays for the next write.
+static int encode_pending(AudioEncoder* enc)
+{
+    int nb_samples = enc->pendingSize / enc->blockAlign;
+    int bytes = nb_samples * enc->blockAlign;
+
+    if (nb_samples == 0)
+        return 0;
+
+    int ret = enc->ctx ? encode_samples(enc, nb_samples) : write_samples(enc, nb_samples);
+    enc->nextPts += nb_samples;
+
+    enc->pendingSize -= bytes;
+    memmove(enc->pending, enc->pending + bytes, enc->pendingSize);
+
+    return ret;
+}
+
+// Callback behind the input sink. The data comes in order, offset is not needed.
+static int encode_write(void* opaque, int64_t offset, const uint8_t* buf, int size)
+{
+    AudioEncoder* enc = (AudioEncoder*)opaque;
+    int left = size;
+
+    (void)offset;
+    while (left > 0) {
+        int chunk = FFMIN(left, enc->frameBytes - enc->pendingSize);
+        memcpy(enc->pending + enc->pendingSize, buf, chunk);
+        enc->pendingSize += chunk;
+        buf += chunk;
+        left -= chunk;
+
+        if (enc->pendingSize == enc->frameBytes && encode_pending(enc) < 0)
+            return -1;
+    }
+
+    return size;
+}
+
+// Frames of frame_size samples, staged packed in pending.
+static int alloc_buffers(AudioEncoder* enc, const OutputFormat* format, int frame_size)
+{
+    enc->blockAlign = output_format_block_align(format);
+    enc->channels = output_format_channels(format);
+    enc->frameBytes = frame_size * enc->blockAlign;
+
+    enc->pkt = av_packet_alloc();
+    enc->pending = (uint8_t*)av_malloc(enc->frameBytes);
+    return enc->pkt && enc->pending ? 0 : AVERROR(ENOMEM);
+}
+
+static int open_codec(AudioEncoder* enc, enum AudioCodec codec, const OutputFormat* format)
+{
+    const AudioCodecInfo* info = &codec_info[codec];
+    const AVCodec* encoder = avcodec_find_encoder(info->id);
+
+    if (!encoder) {
+        fprintf(stderr, "Encoder %s not found\n", info->name);
+        return AVERROR_ENCODER_NOT_FOUND;
+    }
+
+    enc->ctx = avcodec_alloc_context3(encoder);
+    if (!enc->ctx) {
+        fprintf(stderr, "Could not allocate audio codec context\n");
+        return AVERROR(ENOMEM);
+    }
+
+    // The samples arrive packed; a planar encoder gets them deinterleaved.
+    AVCodecContext* ctx = enc->ctx;
+    enum AVSampleFormat planar = av_get_planar_sample_fmt(format->sampleFmt);
+    ctx->sample_fmt = AV_SAMPLE_FMT_NONE;
+    for (const enum AVSampleFormat* fmt = encoder->sample_fmts; fmt && *fmt != AV_SAMPLE_FMT_NONE; fmt++) {
+        if (*fmt == format->sampleFmt || *fmt == planar) {
+            ctx->sample_fmt = *fmt;
+            break;
+        }
+    }
+    if (ctx->sample_fmt == AV_SAMPLE_FMT_NONE) {
+        fprintf(stderr, "Encoder %s does not take %s samples\n", info->name, av_get_sample_fmt_name(format->sampleFmt));
+        return AVERROR(EINVAL);
+    }
+
+    // The g722 encoder takes any rate and labels the stream with it, but the
+    // codec itself only exists at 16 kHz.
+    if (format->sampleRate != audio_codec_sample_rate(codec, format->sampleRate)) {
+        fprintf(stderr, "Encoder %s needs %d Hz\n", info->name, audio_codec_sample_rate(codec, format->sampleRate));
+        return AVERROR(EINVAL);
+    }
+    ctx->sample_rate = format->sampleRate;
+    ctx->channel_layout = format->channelLayout;
+    ctx->channels = output_format_channels(format);
+    ctx->time_base = enc->timeBase;
+    // 4 bits per sample, the 32 kbit/s of G.726 at 8 kHz.
+    if (codec == AUDIO_CODEC_G726)
+        ctx->bit_rate = 4 * format->sampleRate;
+
+    // No encoder version strings, so the same input always gives the same file.
+    ctx->flags |= AV_CODEC_FLAG_BITEXACT;
+    if (enc->mux->oformat->flags & AVFMT_GLOBALHEADER)
+        ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    int ret = avcodec_open2(ctx, encoder, NULL);
+    if (ret < 0) {
+        fprintf(stderr, "Could not open encoder %s\n", info->name);
+        return ret;
+    }
+
+    ret = avcodec_parameters_from_context(enc->mux->streams[0]->codecpar, ctx);
+    if (ret < 0)
+        return ret;
+
+    int frame_size = ctx->frame_size > 0 ? ctx->frame_size : AUDIO_ENCODER_FRAME;
+    ret = alloc_buffers(enc, format, frame_size);
+    if (ret < 0)
+        return ret;
+
+    enc->frame = av_frame_alloc();
+    if (!enc->frame)
+        return AVERROR(ENOMEM);
+    enc->frame->format = ctx->sample_fmt;
+    enc->frame->channel_layout = ctx->channel_layout;
+    enc->frame->channels = ctx->channels;
+    enc->frame->sample_rate = ctx->sample_rate;
+    enc->frame->nb_samples = frame_size;
+    return av_frame_get_buffer(enc->frame, 0);
+}
+
+// PCM needs no encoder, only stream parameters for the muxer.
+static int open_pcm(AudioEncoder* enc, const OutputFormat* format)
+{
+    AVCodecParameters* par = enc->mux->streams[0]->codecpar;
+
+    par->codec_type = AVMEDIA_TYPE_AUDIO;
+    par->codec_id = enc->pcmId;
+    par->format = format->sampleFmt;
+    par->sample_rate = format->sampleRate;
+    par->channel_layout = format->channelLayout;
+    par->channels = output_format_channels(format);
+    par->bits_per_coded_sample = av_get_bits_per_sample(enc->pcmId);
+    par->block_align = output_format_block_align(format);
+    par->bit_rate = (int64_t)format->sampleRate * par->block_align * 8;
+
+    return alloc_buffers(enc, format, AUDIO_ENCODER_PCM_FRAMES);
+}
+
+static int open_muxer(AudioEncoder* enc, int seekable)
+{
+    AVFormatContext* mux = enc->mux;
+
+    uint8_t* buffer = (uint8_t*)av_malloc(AUDIO_ENCODER_IO_SIZE);
+    if (!buffer)
+        return AVERROR(ENOMEM);
+
+    // Without a seek callback the muxer streams and leaves the sizes as they are.
+    mux->pb = avio_alloc_context(buffer, AUDIO_ENCODER_IO_SIZE, 1, enc, NULL, io_write, seekable ? io_seek : NULL);
+    if (!mux->pb) {
+        av_free(buffer);
+        return AVERROR(ENOMEM);
+    }
+    mux->flags |= AVFMT_FLAG_BITEXACT;
+
+    int ret = avformat_write_header(mux, NULL);
+    if (ret < 0)
+        fprintf(stderr, "Could not write the %s header\n", mux->oformat->name);
+    return ret;
+}
+
+int audio_encoder_open(AudioEncoder** encoder, enum AudioCodec codec, enum AudioContainer container,
+                       const OutputFormat* format, OutputSink* dest, int seekable)
+{
+    enum AVCodecID pcm_id = AV_CODEC_ID_NONE;
+
+    *encoder = NULL;
+    if (codec == AUDIO_CODEC_PCM) {
+        pcm_id = pcm_codec_id(format, container_info[container].bigEndian);
+        if (pcm_id == AV_CODEC_ID_NONE) {
+            fprintf(stderr, "Unsupported sample format for %s output\n", container_info[container].name);
+            return AVERROR(EINVAL);
+        }
+    }
+    else if (format->law != G711_NONE)
+        return AVERROR(EINVAL);
+
+    const char* muxer = muxer_name(codec, container, pcm_id);
+    if (!muxer) {
+        fprintf(stderr, "No raw stream format for %s\n",
+                codec == AUDIO_CODEC_PCM ? avcodec_get_name(pcm_id) : codec_info[codec].name);
+        return AVERROR(EINVAL);
+    }
+
+    AudioEncoder* enc = (AudioEncoder*)av_mallocz(sizeof(AudioEncoder));
+    if (!enc)
+        return AVERROR(ENOMEM);
+
+    enc->pcmId = pcm_id;
+    enc->timeBase = AVRational{ 1, format->sampleRate };
+    enc->dest = dest;
+    enc->destBase = dest->pos;
+    output_sink_init_callback(&enc->input, encode_write, enc);
+
+    // The muxer comes first, the encoder needs its global header flag.
+    int ret = avformat_alloc_output_context2(&enc->mux, NULL, muxer, NULL);
+    if (ret >= 0 && !avformat_new_stream(enc->mux, NULL))
+        ret = AVERROR(ENOMEM);
+    if (ret >= 0) {
+        enc->mux->streams[0]->time_base = enc->timeBase;
+        ret = codec == AUDIO_CODEC_PCM ? open_pcm(enc, format) : open_codec(enc, codec, format);
+    }
+    if (ret >= 0)
+        ret = open_muxer(enc, seekable);
+
+    if (ret < 0) {
+        audio_encoder_free(&enc);
+        return ret;
+    }
+
+    *encoder = enc;
+    return 0;
+}
+
+OutputSink* audio_encoder_input(AudioEncoder* encoder)
+{
+    return &encoder->input;
+}
+
+int audio_encoder_finish(AudioEncoder* encoder)
+{
+    int ret = encode_pending(encoder);
+    if (ret >= 0 && encoder->ctx)
+        ret = encode_frame(encoder, NULL);
+
+    int trailer = av_write_trailer(encoder->mux);
+    if (ret >= 0)
+        ret = trailer;
+    if (ret >= 0) {
+        avio_flush(encoder->mux->pb);
+        ret = encoder->mux->pb->error;
+    }
+
+    return ret;
+}
+
+void audio_encoder_free(AudioEncoder** encoder)
+{
+    AudioEncoder* enc = *encoder;
+    if (!enc)
+        return;
+
+    if (enc->mux) {
+        if (enc->mux->pb) {
+            av_freep(&enc->mux->pb->buffer);
+            avio_context_free(&enc->mux->pb);
+        }
+        avformat_free_context(enc->mux);
+    }
+    avcodec_free_context(&enc->ctx);
+    av_frame_free(&enc->frame);
+    av_packet_free(&enc->pkt);
+    av_freep(&enc->pending);
+    av_freep(encoder);
+}
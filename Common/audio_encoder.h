@@ -0,0 +1,68 @@
+// audio_encoder.h : Compressed or muxed output, a libavcodec encoder and libavformat muxer behind an OutputSink.
+//
+
+#pragma once
+
+#include "output_format.h"
+#include "output_sink.h"
+
+enum AudioCodec {
+    AUDIO_CODEC_PCM,            // no encoder, samples behind the hand-built WAV header
+    AUDIO_CODEC_FLAC,           // FLAC stream (.flac), s16 or s32 input
+    AUDIO_CODEC_ADPCM_IMA,      // IMA ADPCM in WAV, mono or stereo
+    AUDIO_CODEC_ADPCM_MS,       // Microsoft ADPCM in WAV, mono or stereo
+    AUDIO_CODEC_G722,           // G.722 in WAV, mono at 16 kHz
+    AUDIO_CODEC_G726,           // G.726 at 32 kbit/s in WAV, mono at 8 kHz
+};
+
+// Container written by the libavformat muxer.
+enum AudioContainer {
+    AUDIO_CONTAINER_DEFAULT,    // the codec's own: the hand-built WAV header for PCM
+    AUDIO_CONTAINER_WAV,
+    AUDIO_CONTAINER_AU,         // big-endian samples, u8 stored as s8
+    AUDIO_CONTAINER_CAF,
+    AUDIO_CONTAINER_RAW,        // samples only (s16le, u8, s32le, f32le, mulaw, alaw), or the FLAC, G.722 or G.726 stream
+    AUDIO_CONTAINER_MKV,        // Matroska audio (.mka)
+};
+
+typedef struct AUDIO_ENCODER AudioEncoder;
+
+// Parses pcm, flac, adpcm_ima, adpcm_ms, g722 or g726. Returns 0 or a negative AVERROR.
+int audio_codec_parse(const char* name, enum AudioCodec* codec);
+
+// Parses wav, au, caf, raw or mkv. Returns 0 or a negative AVERROR.
+int audio_container_parse(const char* name, enum AudioContainer* container);
+
+// True when the output goes through audio_encoder_open(), false when it is
+// PCM behind the hand-built WAV header.
+int audio_encoder_needed(enum AudioCodec codec, enum AudioContainer container);
+
+// Sample format the conversion has to deliver to codec in place of the
+// requested one: FLAC keeps s32, every other encoder takes s16.
+enum AVSampleFormat audio_codec_sample_fmt(enum AudioCodec codec, enum AVSampleFormat requested);
+
+// Sample rate the conversion has to deliver to codec in place of the requested
+// one: G.722 is always 16000 Hz, the others take any rate.
+int audio_codec_sample_rate(enum AudioCodec codec, int requested);
+
+// File name extension of the output, with the dot.
+const char* audio_encoder_extension(enum AudioCodec codec, enum AudioContainer container);
+
+// Opens the encoder for format, which must be in the sample format
+// audio_codec_sample_fmt() returns, and writes the container header to dest.
+// PCM, G.711 included, goes to the muxer as it is, byte swapped for AU.
+// seekable lets the muxer go back to fill in sizes once the stream ends; dest
+// then has to support output_sink_write_at() on everything written so far.
+// Returns 0 or a negative AVERROR.
+int audio_encoder_open(AudioEncoder** encoder, enum AudioCodec codec, enum AudioContainer container,
+                       const OutputFormat* format, OutputSink* dest, int seekable);
+
+// Sink taking the converted samples in place of dest. Writes may split sample
+// frames; everything reaches dest encoded.
+OutputSink* audio_encoder_input(AudioEncoder* encoder);
+
+// Encodes the last partial frame, drains the encoder and writes the trailer.
+// Returns 0 or a negative AVERROR.
+int audio_encoder_finish(AudioEncoder* encoder);
+
+void audio_encoder_free(AudioEncoder** encoder);
@@ -0,0 +1,165 @@
+// avio_input.cpp : Memory and callback backed AVIOContext for the demuxer.
+//
+
+#include "avio_input.h"
+
+#include <cstdio>
+#include <cstring>
+
+#define AVIO_BUFFER_SIZE 65536
+
+typedef struct AVIO_READER {
+    // Memory source
+    const uint8_t* data;
+    size_t size;
+    size_t pos;
+
+    // Callback source
+    AvioReadFunc read;
+    AvioSeekFunc seek;
+    void* opaque;
+} AvioReader;
+
+static int read_buffer(void* opaque, uint8_t* buf, int buf_size)
+{
+    AvioReader* reader = (AvioReader*)opaque;
+    size_t left = reader->size - reader->pos;
+
+    if (left == 0)
+        return AVERROR_EOF;
+    if ((size_t)buf_size > left)
+        buf_size = (int)left;
+
+    memcpy(buf, reader->data + reader->pos, buf_size);
+    reader->pos += buf_size;
+    return buf_size;
+}
+
+static int64_t seek_buffer(void* opaque, int64_t offset, int whence)
+{
+    AvioReader* reader = (AvioReader*)opaque;
+    int64_t pos;
+
+    switch (whence & ~AVSEEK_FORCE) {
+    case AVSEEK_SIZE:
+        return (int64_t)reader->size;
+    case SEEK_SET:
+        pos = offset;
+        break;
+    case SEEK_CUR:
+        pos = (int64_t)reader->pos + offset;
+        break;
+    case SEEK_END:
+        pos = (int64_t)reader->size + offset;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+
+    if (pos < 0 || pos > (int64_t)reader->size)
+        return AVERROR(EINVAL);
+
+    reader->pos = (size_t)pos;
+    return pos;
+}
+
+static int read_callback(void* opaque, uint8_t* buf, int buf_size)
+{
+    AvioReader* reader = (AvioReader*)opaque;
+    int ret = reader->read(reader->opaque, buf, buf_size);
+    return ret == 0 ? AVERROR_EOF : ret;
+}
+
+static int64_t seek_callback(void* opaque, int64_t offset, int whence)
+{
+    AvioReader* reader = (AvioReader*)opaque;
+    return reader->seek(reader->opaque, offset, whence);
+}
+
+static int open_reader(AVFormatContext** format, AvioReader* reader,
+                       int (*read)(void*, uint8_t*, int), int64_t (*seek)(void*, int64_t, int))
+{
+    uint8_t* avio_buffer = (uint8_t*)av_malloc(AVIO_BUFFER_SIZE);
+    if (!avio_buffer) {
+        av_free(reader);
+        return AVERROR(ENOMEM);
+    }
+
+    AVIOContext* pb = avio_alloc_context(avio_buffer, AVIO_BUFFER_SIZE, 0, reader, read, NULL, seek);
+    if (!pb) {
+        av_free(avio_buffer);
+        av_free(reader);
+        return AVERROR(ENOMEM);
+    }
+
+    AVFormatContext* fmt = avformat_alloc_context();
+    if (!fmt) {
+        av_freep(&pb->buffer);
+        avio_context_free(&pb);
+        av_free(reader);
+        return AVERROR(ENOMEM);
+    }
+    fmt->pb = pb;
+    fmt->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+    int ret = avformat_open_input(&fmt, NULL, NULL, NULL);
+    if (ret < 0) {
+        // avformat_open_input() frees fmt on failure but leaves custom IO to us.
+        fprintf(stderr, "Could not open input from custom IO\n");
+        av_freep(&pb->buffer);
+        avio_context_free(&pb);
+        av_free(reader);
+        return ret;
+    }
+
+    *format = fmt;
+    return 0;
+}
+
+int avio_input_open_buffer(AVFormatContext** format, const uint8_t* data, size_t size)
+{
+    AvioReader* reader = (AvioReader*)av_mallocz(sizeof(AvioReader));
+    if (!reader)
+        return AVERROR(ENOMEM);
+
+    reader->data = data;
+    reader->size = size;
+
+    return open_reader(format, reader, read_buffer, seek_buffer);
+}
+
+int avio_input_open_callbacks(AVFormatContext** format, AvioReadFunc read, AvioSeekFunc seek, void* opaque)
+{
+    if (!read)
+        return AVERROR(EINVAL);
+
+    AvioReader* reader = (AvioReader*)av_mallocz(sizeof(AvioReader));
+    if (!reader)
+        return AVERROR(ENOMEM);
+
+    reader->read = read;
+    reader->seek = seek;
+    reader->opaque = opaque;
+
+    return open_reader(format, reader, read_callback, seek ? seek_callback : NULL);
+}
+
+void avio_input_close(AVFormatContext** format)
+{
+    AVFormatContext* fmt = *format;
+    if (!fmt)
+        return;
+
+    if (!(fmt->flags & AVFMT_FLAG_CUSTOM_IO)) {
+        avformat_close_input(format);
+        return;
+    }
+
+    AVIOContext* pb = fmt->pb;
+    avformat_close_input(format);
+    if (pb) {
+        av_free(pb->opaque);
+        av_freep(&pb->buffer);
+        avio_context_free(&pb);
+    }
+}
@@ -0,0 +1,26 @@
+// avio_input.h : Opens a demuxer on memory or caller callbacks instead of a path.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+// Same contract as the avio_alloc_context() callbacks: read returns the number of
+// bytes read or AVERROR_EOF, seek handles SEEK_SET/SEEK_CUR/SEEK_END and AVSEEK_SIZE.
+typedef int (*AvioReadFunc)(void* opaque, uint8_t* buf, int buf_size);
+typedef int64_t (*AvioSeekFunc)(void* opaque, int64_t offset, int whence);
+
+// Opens format on size bytes at data. The buffer must stay valid until
+// avio_input_close(). Returns 0 or a negative AVERROR.
+int avio_input_open_buffer(AVFormatContext** format, const uint8_t* data, size_t size);
+
+// Opens format on read/seek callbacks. seek may be NULL for non-seekable input.
+int avio_input_open_callbacks(AVFormatContext** format, AvioReadFunc read, AvioSeekFunc seek, void* opaque);
+
+// Closes a context opened by either function above, or by avformat_open_input().
+void avio_input_close(AVFormatContext** format);
@@ -0,0 +1,86 @@
+// batch.cpp : Worker pool pulling jobs from a size-ordered queue.
+//
+
+#include "batch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "compat.h"
+
+extern "C" {
+#include <libavutil/time.h>
+}
+
+static int64_t file_size(const char* path)
+{
+    FILE* f;
+    if (fopen_s(&f, path, "rb") != 0)
+        return 0;
+
+    int64_t size = fseek64(f, 0, SEEK_END) == 0 ? ftell64(f) : 0;
+    fclose(f);
+    return size;
+}
+
+int batch_default_threads(void)
+{
+    unsigned int n = std::thread::hardware_concurrency();
+    return n ? (int)n : 1;
+}
+
+void batch_run(BatchJob* jobs, int count, int threads, BatchConvertFunc convert, void* opaque, BatchSummary* summary)
+{
+    std::vector<BatchJob*> queue;
+    std::atomic<int> next(0);
+    int64_t start = av_gettime_relative();
+
+    for (int i = 0; i < count; i++) {
+        jobs[i].input_size = file_size(jobs[i].input);
+        jobs[i].result = -1;
+        jobs[i].audio_seconds = 0;
+        jobs[i].seconds = 0;
+        queue.push_back(&jobs[i]);
+    }
+
+    // Input size stands in for duration; it is exact for PCM and close enough
+    // for constant bitrate codecs.
+    std::stable_sort(queue.begin(), queue.end(),
+                     [](const BatchJob* a, const BatchJob* b) { return a->input_size > b->input_size; });
+
+    if (threads <= 0)
+        threads = batch_default_threads();
+    if (threads > count)
+        threads = count;
+
+    auto worker = [&]() {
+        for (int i = next++; i < count; i = next++) {
+            BatchJob* job = queue[i];
+            int64_t job_start = av_gettime_relative();
+            job->result = convert(opaque, job->input, job->output, &job->audio_seconds);
+            job->seconds = (av_gettime_relative() - job_start) / 1000000.0;
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int i = 1; i < threads; i++)
+        pool.emplace_back(worker);
+    worker();
+    for (std::thread& t : pool)
+        t.join();
+
+    if (summary) {
+        summary->files = count;
+        summary->failed = 0;
+        summary->audio_seconds = 0;
+        for (int i = 0; i < count; i++) {
+            if (jobs[i].result < 0)
+                summary->failed++;
+            else
+                summary->audio_seconds += jobs[i].audio_seconds;
+        }
+        summary->wall_seconds = (av_gettime_relative() - start) / 1000000.0;
+    }
+}
@@ -0,0 +1,37 @@
+// batch.h : Runs many conversions on a pool of worker threads, longest first.
+//
+
+#pragma once
+
+#include <cstdint>
+
+// Converts input into output. opaque is the pointer handed to batch_run(), shared
+// by every worker. Returns >= 0 on success and sets *audio_seconds to the
+// duration written, or 0 when unknown.
+typedef int (*BatchConvertFunc)(void* opaque, const char* input, const char* output, double* audio_seconds);
+
+typedef struct BATCH_JOB {
+    const char* input;
+    const char* output;
+
+    // Filled in by batch_run().
+    int64_t input_size;
+    int result;
+    double audio_seconds;
+    double seconds;
+} BatchJob;
+
+typedef struct BATCH_SUMMARY {
+    int files;
+    int failed;
+    double wall_seconds;
+    double audio_seconds;
+} BatchSummary;
+
+// Number of hardware threads, at least 1.
+int batch_default_threads(void);
+
+// Converts every job with up to threads workers (0 picks batch_default_threads()).
+// Jobs are started in order of decreasing input size, so the longest conversions
+// do not end up alone at the tail of the batch. summary may be NULL.
+void batch_run(BatchJob* jobs, int count, int threads, BatchConvertFunc convert, void* opaque, BatchSummary* summary);
@@ -0,0 +1,31 @@
+// compat.h : Small portability shims shared by the projects.
+//
+
+#pragma once
+
+#include <cstdio>
+
+// 64-bit file positions, long is 32 bits on Windows.
+#ifdef _WIN32
+#define fseek64 _fseeki64
+#define ftell64 _ftelli64
+#else
+#define fseek64 fseeko
+#define ftell64 ftello
+#endif
+
+#ifndef _WIN32
+#include <cerrno>
+
+static inline int fopen_s(FILE** file, const char* filename, const char* mode)
+{
+    *file = fopen(filename, mode);
+    return *file ? 0 : errno;
+}
+
+static inline int tmpfile_s(FILE** file)
+{
+    *file = tmpfile();
+    return *file ? 0 : errno;
+}
+#endif
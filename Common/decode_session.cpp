@@ -0,0 +1,222 @@
+// decode_session.cpp : Decodes packets and resamples every frame into one reused buffer.
+//
+
+#include "decode_session.h"
+
+#include <vector>
+
+extern "C" {
+#include <libavutil/channel_layout.h>
+#include <libavutil/samplefmt.h>
+}
+
+static int64_t frame_ch_layout(const AVFrame* frame)
+{
+    return frame->channel_layout ? frame->channel_layout : av_get_default_channel_layout(frame->channels);
+}
+
+static int frame_matches_output(const DecodeSession* session, const AVFrame* frame)
+{
+    return session->out_law == G711_NONE &&
+           frame->format == session->out_sample_fmt &&
+           frame->sample_rate == session->out_sample_rate &&
+           frame_ch_layout(frame) == session->out_ch_layout;
+}
+
+static int init_resampler(DecodeSession* session, const AVFrame* frame)
+{
+    SwrPoolKey key;
+
+    key.inChannelLayout = frame_ch_layout(frame);
+    key.inSampleRate = frame->sample_rate;
+    key.inSampleFmt = static_cast<AVSampleFormat>(frame->format);
+    key.outChannelLayout = session->out_ch_layout;
+    key.outSampleRate = session->out_sample_rate;
+    key.outSampleFmt = session->out_sample_fmt;
+
+    return resampler_open(&session->resampler, &key, session->out_law);
+}
+
+static int reserve_output(DecodeSession* session, int in_nb_samples)
+{
+    int needed = resampler_get_out_samples(&session->resampler, in_nb_samples);
+    if (needed < 0)
+        return needed;
+    if (needed <= session->dst_nb_samples)
+        return 0;
+
+    int ret;
+    if (!session->dst_data) {
+        ret = av_samples_alloc_array_and_samples(&session->dst_data, &session->dst_linesize,
+                                                 session->out_nb_channels, needed, session->out_sample_fmt, 0);
+    }
+    else {
+        av_freep(&session->dst_data[0]);
+        ret = av_samples_alloc(session->dst_data, &session->dst_linesize,
+                               session->out_nb_channels, needed, session->out_sample_fmt, 0);
+    }
+    if (ret < 0) {
+        fprintf(stderr, "Could not allocate destination samples\n");
+        session->dst_nb_samples = 0;
+        return ret;
+    }
+
+    session->dst_nb_samples = needed;
+    return 0;
+}
+
+static int write_output(DecodeSession* session, int nb_samples, OutputSink* sink)
+{
+    return output_sink_write(sink, session->dst_data[0], (size_t)nb_samples * session->out_block_align);
+}
+
+static int convert_samples(DecodeSession* session, const uint8_t** in, int in_nb_samples, OutputSink* sink)
+{
+    int ret = reserve_output(session, in_nb_samples);
+    if (ret < 0)
+        return ret;
+
+    ret = resampler_convert(&session->resampler, session->dst_data, session->dst_nb_samples, in, in_nb_samples);
+    if (ret < 0) {
+        fprintf(stderr, "Error while converting\n");
+        return ret;
+    }
+
+    return write_output(session, ret, sink);
+}
+
+static int receive_frames(DecodeSession* session, OutputSink* sink)
+{
+    int written = 0;
+
+    for (;;) {
+        int ret = avcodec_receive_frame(session->dec_ctx, session->frame);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+            return written;
+        else if (ret < 0) {
+            fprintf(stderr, "Error during decoding\n");
+            return ret;
+        }
+        AVFrame* frame = session->frame;
+        int skip = session->input_func ? session->input_func(session->input_opaque, frame) : 0;
+        if (skip < 0 || skip >= frame->nb_samples) {
+            av_frame_unref(frame);
+            if (skip < 0)
+                return skip;
+            continue;
+        }
+
+        // Dropping leading samples moves every plane's start.
+        const uint8_t** in = (const uint8_t**)frame->extended_data;
+        std::vector<const uint8_t*> moved;
+        if (skip > 0) {
+            int planar = av_sample_fmt_is_planar((enum AVSampleFormat)frame->format);
+            int stride = av_get_bytes_per_sample((enum AVSampleFormat)frame->format) * (planar ? 1 : frame->channels);
+            for (int p = 0; p < (planar ? frame->channels : 1); p++)
+                moved.push_back(in[p] + (size_t)skip * stride);
+            in = moved.data();
+        }
+        int nb_samples = frame->nb_samples - skip;
+
+        // Once a resampler exists every frame goes through it, so no samples
+        // held in its delay line can be overtaken.
+        if (!resampler_is_open(&session->resampler) && frame_matches_output(session, frame)) {
+            int size = nb_samples * session->out_block_align;
+            ret = output_sink_write(sink, in[0], size);
+        }
+        else {
+            if (!resampler_is_open(&session->resampler)) {
+                ret = init_resampler(session, session->frame);
+                if (ret < 0) {
+                    av_frame_unref(session->frame);
+                    return ret;
+                }
+            }
+
+            ret = convert_samples(session, in, nb_samples, sink);
+        }
+        av_frame_unref(session->frame);
+        if (ret < 0)
+            return ret;
+
+        written += ret;
+    }
+}
+
+int decode_session_open(DecodeSession** session, const AVCodecParameters* params, const OutputFormat* out, int threads)
+{
+    DecodeSession* s = (DecodeSession*)av_mallocz(sizeof(DecodeSession));
+    if (!s)
+        return AVERROR(ENOMEM);
+
+    OutputFormat default_format;
+    if (!out) {
+        output_format_init(&default_format);
+        out = &default_format;
+    }
+
+    s->out_sample_rate = out->sampleRate;
+    s->out_ch_layout = out->channelLayout;
+    s->out_nb_channels = output_format_channels(out);
+    s->out_sample_fmt = out->sampleFmt;
+    s->out_law = out->law;
+    s->out_block_align = output_format_block_align(out);
+
+    int ret = 0;
+    s->dec_ctx = decoder_pool_acquire(params, threads, &s->dec_key, &ret);
+    if (!s->dec_ctx) {
+        decode_session_free(&s);
+        return ret;
+    }
+
+    s->frame = av_frame_alloc();
+    if (!s->frame) {
+        fprintf(stderr, "Could not allocate frame\n");
+        decode_session_free(&s);
+        return AVERROR(ENOMEM);
+    }
+
+    *session = s;
+    return 0;
+}
+
+int decode_session_send_packet(DecodeSession* session, const AVPacket* pkt, OutputSink* sink)
+{
+    int ret = avcodec_send_packet(session->dec_ctx, pkt);
+    if (ret < 0) {
+        fprintf(stderr, "Error submitting the packet to the decoder %d \n", ret);
+        return ret;
+    }
+
+    return receive_frames(session, sink);
+}
+
+int decode_session_flush(DecodeSession* session, OutputSink* sink)
+{
+    int ret = decode_session_send_packet(session, NULL, sink);
+    if (ret < 0 || !resampler_is_open(&session->resampler))
+        return ret;
+
+    int written = ret;
+    for (;;) {
+        ret = convert_samples(session, NULL, 0, sink);
+        if (ret <= 0)
+            return ret < 0 ? ret : written;
+        written += ret;
+    }
+}
+
+void decode_session_free(DecodeSession** session)
+{
+    DecodeSession* s = *session;
+    if (!s)
+        return;
+
+    if (s->dst_data)
+        av_freep(&s->dst_data[0]);
+    av_freep(&s->dst_data);
+    resampler_close(&s->resampler);
+    av_frame_free(&s->frame);
+    decoder_pool_release(&s->dec_key, &s->dec_ctx);
+    av_freep(session);
+}
@@ -0,0 +1,60 @@
+// decode_session.h : Decoder and resampler state that lives for one whole conversion.
+//
+
+#pragma once
+
+#include "decoder_pool.h"
+#include "output_format.h"
+#include "output_sink.h"
+#include "resampler.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+// Sees every decoded frame before it is converted. Returns how many of its
+// leading samples to drop (0 to nb_samples), or a negative AVERROR that stops
+// the frame and is returned to the caller.
+typedef int (*DecodeInputFunc)(void* opaque, const AVFrame* frame);
+
+typedef struct DECODE_SESSION {
+    // Taken from the decoder pool, returned to it under dec_key.
+    AVCodecContext* dec_ctx;
+    DecoderPoolKey dec_key;
+    AVFrame* frame;
+
+    // Optional, set by the caller after decode_session_open().
+    DecodeInputFunc input_func;
+    void* input_opaque;
+
+    // Created from the first decoded frame that does not already match the
+    // output format, so the input side always matches what the decoder really
+    // produces. Frames that match are written without going through it at all.
+    Resampler resampler;
+    int out_sample_rate;
+    int64_t out_ch_layout;
+    int out_nb_channels;
+    enum AVSampleFormat out_sample_fmt;
+    enum G711Law out_law;
+    int out_block_align;
+
+    // Single output buffer, grown only when resampler_get_out_samples() asks for more.
+    uint8_t** dst_data;
+    int dst_linesize;
+    int dst_nb_samples;
+} DecodeSession;
+
+// Gets an opened decoder for params from the decoder pool, converting to out
+// (NULL for the default format). threads is the frame thread count for codecs
+// that support it, see decoder_pool_acquire(). Returns 0 or a negative AVERROR.
+int decode_session_open(DecodeSession** session, const AVCodecParameters* params, const OutputFormat* out, int threads);
+
+// Sends one packet and writes every frame it produces. Returns the number of
+// bytes written to sink or a negative AVERROR.
+int decode_session_send_packet(DecodeSession* session, const AVPacket* pkt, OutputSink* sink);
+
+// Drains the decoder and then the resampler at end of input. Returns the number
+// of bytes written to sink or a negative AVERROR.
+int decode_session_flush(DecodeSession* session, OutputSink* sink);
+
+void decode_session_free(DecodeSession** session);
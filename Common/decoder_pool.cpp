@@ -0,0 +1,169 @@
+// decoder_pool.cpp : Keeps opened decoders around between conversions.
+//
+
+#include "decoder_pool.h"
+
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+typedef struct DECODER_POOL_ENTRY {
+    DecoderPoolKey key;
+    AVCodecContext* dec_ctx;
+} DecoderPoolEntry;
+
+static std::mutex& pool_mutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+static std::vector<DecoderPoolEntry>& pool_entries()
+{
+    static std::vector<DecoderPoolEntry> entries;
+    return entries;
+}
+
+// FNV-1a; the pool only needs to tell extradata blobs of one codec apart.
+static uint64_t hash_bytes(const uint8_t* data, int size)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (int i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static int key_equal(const DecoderPoolKey* a, const DecoderPoolKey* b)
+{
+    return a->codecId == b->codecId &&
+           a->sampleRate == b->sampleRate &&
+           a->channels == b->channels &&
+           a->channelLayout == b->channelLayout &&
+           a->blockAlign == b->blockAlign &&
+           a->bitsPerCodedSample == b->bitsPerCodedSample &&
+           a->extradataSize == b->extradataSize &&
+           a->extradataHash == b->extradataHash &&
+           a->threads == b->threads;
+}
+
+static int has_frame_threads(const AVCodec* codec)
+{
+    return codec && (codec->capabilities & AV_CODEC_CAP_FRAME_THREADS);
+}
+
+static void make_key(const AVCodecParameters* params, int threads, DecoderPoolKey* key)
+{
+    memset(key, 0, sizeof(*key));
+    key->codecId = params->codec_id;
+    key->sampleRate = params->sample_rate;
+    key->channels = params->channels;
+    key->channelLayout = params->channel_layout;
+    key->blockAlign = params->block_align;
+    key->bitsPerCodedSample = params->bits_per_coded_sample;
+    key->extradataSize = params->extradata ? params->extradata_size : 0;
+    key->extradataHash = hash_bytes(params->extradata, key->extradataSize);
+    key->threads = has_frame_threads(avcodec_find_decoder(params->codec_id)) ? threads : 1;
+}
+
+static AVCodecContext* open_decoder(const AVCodecParameters* params, int threads, int* error)
+{
+    const AVCodec* codec = avcodec_find_decoder(params->codec_id);
+    if (!codec) {
+        fprintf(stderr, "Codec not found\n");
+        *error = AVERROR_DECODER_NOT_FOUND;
+        return NULL;
+    }
+
+    AVCodecContext* dec_ctx = avcodec_alloc_context3(codec);
+    if (!dec_ctx) {
+        fprintf(stderr, "Could not allocate audio codec context\n");
+        *error = AVERROR(ENOMEM);
+        return NULL;
+    }
+
+    int ret = avcodec_parameters_to_context(dec_ctx, params);
+    if (ret < 0) {
+        fprintf(stderr, "Could not copy codec parameters\n");
+        avcodec_free_context(&dec_ctx);
+        *error = ret;
+        return NULL;
+    }
+
+    // Frame threading adds a frame of latency per thread but decodes
+    // consecutive frames of lossless codecs (FLAC, ALAC, WavPack) in parallel.
+    if (threads != 1 && has_frame_threads(codec)) {
+        dec_ctx->thread_type = FF_THREAD_FRAME;
+        dec_ctx->thread_count = threads;
+    }
+
+    ret = avcodec_open2(dec_ctx, codec, NULL);
+    if (ret < 0) {
+        fprintf(stderr, "Could not open codec\n");
+        avcodec_free_context(&dec_ctx);
+        *error = ret;
+        return NULL;
+    }
+
+    return dec_ctx;
+}
+
+AVCodecContext* decoder_pool_acquire(const AVCodecParameters* params, int threads, DecoderPoolKey* key, int* error)
+{
+    make_key(params, threads, key);
+
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex());
+        std::vector<DecoderPoolEntry>& entries = pool_entries();
+        for (size_t i = 0; i < entries.size(); i++) {
+            if (key_equal(&entries[i].key, key)) {
+                AVCodecContext* dec_ctx = entries[i].dec_ctx;
+                entries.erase(entries.begin() + i);
+                return dec_ctx;
+            }
+        }
+    }
+
+    return open_decoder(params, key->threads, error);
+}
+
+void decoder_pool_release(const DecoderPoolKey* key, AVCodecContext** dec_ctx)
+{
+    if (!*dec_ctx)
+        return;
+
+    // Drops buffered frames and leaves draining mode, so the next file starts
+    // from a clean decoder.
+    avcodec_flush_buffers(*dec_ctx);
+
+    DecoderPoolEntry entry;
+    entry.key = *key;
+    entry.dec_ctx = *dec_ctx;
+    *dec_ctx = NULL;
+
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex());
+        std::vector<DecoderPoolEntry>& entries = pool_entries();
+        if (entries.size() < DECODER_POOL_MAX_IDLE) {
+            entries.push_back(entry);
+            return;
+        }
+    }
+
+    avcodec_free_context(&entry.dec_ctx);
+}
+
+void decoder_pool_clear(void)
+{
+    std::vector<DecoderPoolEntry> entries;
+
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex());
+        entries.swap(pool_entries());
+    }
+
+    for (DecoderPoolEntry& entry : entries)
+        avcodec_free_context(&entry.dec_ctx);
+}
@@ -0,0 +1,44 @@
+// decoder_pool.h : Process-wide cache of opened decoders.
+//
+
+#pragma once
+
+#include <cstdint>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+// Idle decoders kept per process; a release beyond this frees the decoder.
+#define DECODER_POOL_MAX_IDLE 16
+
+// What a decoder was opened with. Besides the codec and its extradata, the
+// parameters that decoders read once in init (PCM and ADPCM take the rate,
+// channel count and block size from there) have to match as well.
+typedef struct DECODER_POOL_KEY {
+    enum AVCodecID codecId;
+    int sampleRate;
+    int channels;
+    uint64_t channelLayout;
+    int blockAlign;
+    int bitsPerCodedSample;
+    int extradataSize;
+    uint64_t extradataHash;
+
+    // Frame threads asked for; always 1 for codecs without frame threading.
+    int threads;
+} DecoderPoolKey;
+
+// Returns an opened decoder for params, reusing an idle one opened with the
+// same parameters, and fills key for decoder_pool_release(). Codecs that
+// support FF_THREAD_FRAME decode with threads frame threads (0 lets FFmpeg
+// pick one per core); others ignore threads. Returns NULL and sets *error to a
+// negative AVERROR on failure. Thread safe.
+AVCodecContext* decoder_pool_acquire(const AVCodecParameters* params, int threads, DecoderPoolKey* key, int* error);
+
+// Flushes *dec_ctx with avcodec_flush_buffers(), parks it under key and sets
+// *dec_ctx to NULL. Thread safe.
+void decoder_pool_release(const DecoderPoolKey* key, AVCodecContext** dec_ctx);
+
+// Frees every idle decoder.
+void decoder_pool_clear(void);
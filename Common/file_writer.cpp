@@ -0,0 +1,298 @@
+// file_writer.cpp : Few large positioned writes instead of one small fwrite() per frame.
+//
+
+#include "file_writer.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <malloc.h>
+#include <share.h>
+#include <sys/stat.h>
+#else
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+extern "C" {
+#include <libavutil/error.h>
+}
+
+#ifdef _WIN32
+// No pread/pwrite in the CRT; every writer owns its descriptor, so seeking
+// first is safe.
+static int64_t write_at(int fd, const uint8_t* buf, size_t size, int64_t offset)
+{
+    if (_lseeki64(fd, offset, SEEK_SET) < 0)
+        return -1;
+    return _write(fd, buf, (unsigned int)size);
+}
+
+static int64_t write2_at(int fd, const uint8_t* a, size_t a_size, const uint8_t* b, size_t b_size, int64_t offset)
+{
+    int64_t n = write_at(fd, a, a_size, offset);
+    if (n != (int64_t)a_size)
+        return n;
+    int64_t m = write_at(fd, b, b_size, offset + a_size);
+    return m < 0 ? m : n + m;
+}
+
+static uint8_t* alloc_aligned(size_t size)
+{
+    return (uint8_t*)_aligned_malloc(size, FILE_WRITER_ALIGN);
+}
+
+static void free_aligned(uint8_t* ptr)
+{
+    _aligned_free(ptr);
+}
+#else
+static int64_t write_at(int fd, const uint8_t* buf, size_t size, int64_t offset)
+{
+    return pwrite(fd, buf, size, (off_t)offset);
+}
+
+static int64_t write2_at(int fd, const uint8_t* a, size_t a_size, const uint8_t* b, size_t b_size, int64_t offset)
+{
+    struct iovec iov[2];
+    iov[0].iov_base = (void*)a;
+    iov[0].iov_len = a_size;
+    iov[1].iov_base = (void*)b;
+    iov[1].iov_len = b_size;
+    return pwritev(fd, iov, 2, (off_t)offset);
+}
+
+static uint8_t* alloc_aligned(size_t size)
+{
+    void* ptr;
+    return posix_memalign(&ptr, FILE_WRITER_ALIGN, size) == 0 ? (uint8_t*)ptr : NULL;
+}
+
+static void free_aligned(uint8_t* ptr)
+{
+    free(ptr);
+}
+#endif
+
+// Writes all of it, retrying short writes.
+static int write_full(int fd, const uint8_t* buf, size_t size, int64_t offset)
+{
+    while (size > 0) {
+        int64_t n = write_at(fd, buf, size, offset);
+        if (n <= 0)
+            return AVERROR(n < 0 ? errno : EIO);
+        buf += n;
+        size -= (size_t)n;
+        offset += n;
+    }
+    return 0;
+}
+
+static int flush_buffer(FileWriter* writer)
+{
+    if (writer->used == 0)
+        return 0;
+
+    int ret = write_full(writer->fd, writer->buffer, writer->used, writer->buffer_pos);
+    if (ret < 0)
+        return ret;
+
+    writer->buffer_pos += writer->used;
+    writer->used = 0;
+    return 0;
+}
+
+#ifdef O_DIRECT
+// O_DIRECT transfers must be block aligned, which the final partial buffer and
+// a header patch after the fact are not; they go through the page cache.
+static void end_direct(FileWriter* writer)
+{
+    if (!writer->direct)
+        return;
+
+    int flags = fcntl(writer->fd, F_GETFL);
+    if (flags != -1)
+        fcntl(writer->fd, F_SETFL, flags & ~O_DIRECT);
+    writer->direct = 0;
+}
+#else
+static void end_direct(FileWriter* writer)
+{
+    writer->direct = 0;
+}
+#endif
+
+int file_writer_open(FileWriter* writer, const char* path, int flags)
+{
+    memset(writer, 0, sizeof(*writer));
+    writer->fd = -1;
+
+    writer->buffer = alloc_aligned(FILE_WRITER_BUFFER_SIZE);
+    if (!writer->buffer)
+        return AVERROR(ENOMEM);
+
+#ifdef _WIN32
+    (void)flags;
+    _sopen_s(&writer->fd, path, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _SH_DENYWR, _S_IREAD | _S_IWRITE);
+#else
+#ifdef O_DIRECT
+    if (flags & FILE_WRITER_DIRECT) {
+        writer->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0666);
+        writer->direct = writer->fd >= 0;
+    }
+#endif
+    if (writer->fd < 0)
+        writer->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+#endif
+
+    if (writer->fd < 0) {
+        int ret = AVERROR(errno);
+        free_aligned(writer->buffer);
+        writer->buffer = NULL;
+        return ret;
+    }
+
+    return 0;
+}
+
+int file_writer_preallocate(FileWriter* writer, int64_t size)
+{
+    if (size <= 0)
+        return 0;
+
+#if defined(__linux__)
+    // FALLOC_FL_KEEP_SIZE would avoid the trim on close but leaves st_size at
+    // 0 until the end, which confuses readers polling a file in progress.
+    int ret = posix_fallocate(writer->fd, 0, (off_t)size);
+    if (ret != 0)
+        return AVERROR(ret);
+    writer->preallocated = size;
+    return 0;
+#else
+    // Windows reserves clusters only through the handle API, which this
+    // writer does not use; other systems have no cheap equivalent.
+    (void)writer;
+    return AVERROR(ENOSYS);
+#endif
+}
+
+int file_writer_write(FileWriter* writer, const uint8_t* buf, size_t size)
+{
+    size_t total = size;
+
+    // A large write with room left over goes out together with the staging
+    // buffer in one vectored call instead of being copied through it.
+    if (!writer->direct && writer->used + size > FILE_WRITER_BUFFER_SIZE && size >= FILE_WRITER_BUFFER_SIZE / 2) {
+        int64_t n = write2_at(writer->fd, writer->buffer, writer->used, buf, size, writer->buffer_pos);
+        if (n < 0)
+            return AVERROR(errno);
+        if ((size_t)n == writer->used + size) {
+            writer->buffer_pos += n;
+            writer->used = 0;
+            if (writer->buffer_pos > writer->end)
+                writer->end = writer->buffer_pos;
+            return (int)total;
+        }
+
+        // Short vectored write: finish the remainder with plain writes.
+        int64_t pos = writer->buffer_pos + n;
+        size_t from_buffer = (size_t)n < writer->used ? (size_t)n : writer->used;
+        int ret = write_full(writer->fd, writer->buffer + from_buffer, writer->used - from_buffer, pos);
+        if (ret == 0) {
+            size_t done = (size_t)n - from_buffer;
+            ret = write_full(writer->fd, buf + done, size - done, pos + writer->used - from_buffer);
+        }
+        if (ret < 0)
+            return ret;
+        writer->buffer_pos += writer->used + size;
+        writer->used = 0;
+        if (writer->buffer_pos > writer->end)
+            writer->end = writer->buffer_pos;
+        return (int)total;
+    }
+
+    while (size > 0) {
+        size_t n = FILE_WRITER_BUFFER_SIZE - writer->used;
+        if (n > size)
+            n = size;
+        memcpy(writer->buffer + writer->used, buf, n);
+        writer->used += n;
+        buf += n;
+        size -= n;
+
+        if (writer->used == FILE_WRITER_BUFFER_SIZE) {
+            int ret = flush_buffer(writer);
+            if (ret < 0)
+                return ret;
+        }
+    }
+
+    if (writer->buffer_pos + (int64_t)writer->used > writer->end)
+        writer->end = writer->buffer_pos + writer->used;
+    return (int)total;
+}
+
+int file_writer_write_at(FileWriter* writer, int64_t offset, const uint8_t* buf, size_t size)
+{
+    int64_t buffer_end = writer->buffer_pos + (int64_t)writer->used;
+
+    if (offset >= writer->buffer_pos && offset + (int64_t)size <= buffer_end) {
+        memcpy(writer->buffer + (offset - writer->buffer_pos), buf, size);
+        return (int)size;
+    }
+
+    // Only the part before the staging buffer is on disk; flush so nothing
+    // buffered later overwrites the patch. That flush is partial and leaves
+    // the buffer unaligned, so direct I/O ends here.
+    end_direct(writer);
+    int ret = flush_buffer(writer);
+    if (ret < 0)
+        return ret;
+
+    ret = write_full(writer->fd, buf, size, offset);
+    if (ret < 0)
+        return ret;
+
+    if (offset + (int64_t)size > writer->end)
+        writer->end = offset + size;
+    return (int)size;
+}
+
+int file_writer_close(FileWriter* writer)
+{
+    int ret = 0;
+
+    if (writer->fd >= 0) {
+        end_direct(writer);
+        ret = flush_buffer(writer);
+
+        if (ret == 0 && writer->preallocated > writer->end) {
+#ifdef _WIN32
+            if (_chsize_s(writer->fd, writer->end) != 0)
+                ret = AVERROR(EIO);
+#else
+            if (ftruncate(writer->fd, (off_t)writer->end) != 0)
+                ret = AVERROR(errno);
+#endif
+        }
+
+#ifdef _WIN32
+        if (_close(writer->fd) != 0 && ret == 0)
+#else
+        if (close(writer->fd) != 0 && ret == 0)
+#endif
+            ret = AVERROR(EIO);
+        writer->fd = -1;
+    }
+
+    if (writer->buffer)
+        free_aligned(writer->buffer);
+    writer->buffer = NULL;
+
+    return ret;
+}
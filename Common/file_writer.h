@@ -0,0 +1,48 @@
+// file_writer.h : Output file written through a large page-aligned staging buffer.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Staging buffer size; every flush but the last is one write of this size.
+#define FILE_WRITER_BUFFER_SIZE (1024 * 1024)
+
+// Alignment of the buffer, of flush offsets and of O_DIRECT transfers.
+#define FILE_WRITER_ALIGN 4096
+
+// Bypass the page cache with O_DIRECT where supported (Linux). Falls back to
+// buffered I/O when the file system refuses it. Ignored elsewhere.
+#define FILE_WRITER_DIRECT 1
+
+typedef struct FILE_WRITER {
+    int fd;
+    int direct;
+
+    uint8_t* buffer;
+    size_t used;
+    int64_t buffer_pos;     // file offset of buffer[0]
+
+    int64_t end;            // highest offset written so far
+    int64_t preallocated;
+} FileWriter;
+
+// Creates or truncates path. flags is 0 or FILE_WRITER_DIRECT.
+// Returns 0 or a negative AVERROR.
+int file_writer_open(FileWriter* writer, const char* path, int flags);
+
+// Reserves size bytes on disk up front so the file is laid out in one extent.
+// The file is cut back to what was written on close. Returns 0 or a negative
+// AVERROR; failure is harmless and only means no reservation.
+int file_writer_preallocate(FileWriter* writer, int64_t size);
+
+// Appends size bytes. Returns size or a negative AVERROR.
+int file_writer_write(FileWriter* writer, const uint8_t* buf, size_t size);
+
+// Overwrites bytes at offset, in the staging buffer if they are still there and
+// with a positioned write otherwise. Returns size or a negative AVERROR.
+int file_writer_write_at(FileWriter* writer, int64_t offset, const uint8_t* buf, size_t size);
+
+// Flushes, trims any preallocation and closes. Returns 0 or a negative AVERROR.
+int file_writer_close(FileWriter* writer);
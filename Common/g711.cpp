@@ -0,0 +1,163 @@
+// g711.cpp : Segment search reference and an SSE2 encoder that reads the segment off the float exponent.
+//
+
+#include "g711.h"
+
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define G711_SSE2 1
+#include <emmintrin.h>
+#else
+#define G711_SSE2 0
+#endif
+
+// Largest 14-bit magnitude mu-law represents, and the bias added before the
+// segment search.
+#define ULAW_CLIP 8159
+#define ULAW_BIAS 33
+
+static int segment(int value, int first_end)
+{
+    int seg = 0;
+    for (int end = first_end; seg < 8 && value > end; end = end * 2 + 1)
+        seg++;
+    return seg;
+}
+
+static uint8_t encode_ulaw(int16_t sample)
+{
+    int value = sample >> 2;
+    int mask = 0xFF;
+
+    if (value < 0) {
+        value = -value;
+        mask = 0x7F;
+    }
+    if (value > ULAW_CLIP)
+        value = ULAW_CLIP;
+    value += ULAW_BIAS;
+
+    int seg = segment(value, 0x3F);
+    if (seg >= 8)
+        return (uint8_t)(0x7F ^ mask);
+    return (uint8_t)(((seg << 4) | ((value >> (seg + 1)) & 0xF)) ^ mask);
+}
+
+static uint8_t encode_alaw(int16_t sample)
+{
+    int value = sample >> 3;
+    int mask = 0xD5;
+
+    if (value < 0) {
+        value = -value - 1;
+        mask = 0x55;
+    }
+
+    int seg = segment(value, 0x1F);
+    if (seg >= 8)
+        return (uint8_t)(0x7F ^ mask);
+    int mantissa = seg < 2 ? (value >> 1) & 0xF : (value >> seg) & 0xF;
+    return (uint8_t)(((seg << 4) | mantissa) ^ mask);
+}
+
+#if G711_SSE2
+
+// Both laws code a magnitude as a segment, the position of its leading one
+// bit, and the four bits after it. Converted to float, those are the exponent
+// and the top four mantissa bits, so the search becomes two shifts.
+static inline __m128i segment_code(__m128i magnitude, int exponent_bias)
+{
+    __m128i bits = _mm_castps_si128(_mm_cvtepi32_ps(magnitude));
+    __m128i seg = _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(exponent_bias));
+    __m128i mantissa = _mm_and_si128(_mm_srli_epi32(bits, 19), _mm_set1_epi32(0xF));
+    return _mm_or_si128(_mm_slli_epi32(seg, 4), mantissa);
+}
+
+static inline __m128i ulaw4(__m128i sample)
+{
+    __m128i value = _mm_srai_epi32(sample, 2);
+    __m128i sign = _mm_srai_epi32(value, 31);
+    __m128i magnitude = _mm_sub_epi32(_mm_xor_si128(value, sign), sign);
+
+    // Clipping one below ULAW_CLIP lands on code 0x7F, which is what the
+    // reference returns for the overflowing segment too.
+    __m128i over = _mm_cmpgt_epi32(magnitude, _mm_set1_epi32(ULAW_CLIP - 1));
+    magnitude = _mm_or_si128(_mm_andnot_si128(over, magnitude), _mm_and_si128(over, _mm_set1_epi32(ULAW_CLIP - 1)));
+    magnitude = _mm_add_epi32(magnitude, _mm_set1_epi32(ULAW_BIAS));
+
+    __m128i mask = _mm_xor_si128(_mm_set1_epi32(0xFF), _mm_and_si128(sign, _mm_set1_epi32(0x80)));
+    return _mm_xor_si128(segment_code(magnitude, 127 + 5), mask);
+}
+
+static inline __m128i alaw4(__m128i sample)
+{
+    __m128i value = _mm_srai_epi32(sample, 3);
+    __m128i sign = _mm_srai_epi32(value, 31);
+    __m128i magnitude = _mm_xor_si128(value, sign);     // -value - 1 when negative
+
+    // Segment 0 is linear: below 32 the code is the magnitude halved.
+    __m128i small = _mm_cmplt_epi32(magnitude, _mm_set1_epi32(32));
+    __m128i code = _mm_or_si128(_mm_and_si128(small, _mm_srli_epi32(magnitude, 1)),
+                                _mm_andnot_si128(small, segment_code(magnitude, 127 + 4)));
+
+    __m128i mask = _mm_xor_si128(_mm_set1_epi32(0xD5), _mm_and_si128(sign, _mm_set1_epi32(0x80)));
+    return _mm_xor_si128(code, mask);
+}
+
+template <__m128i (*ENCODE)(__m128i)>
+static int encode_sse2(const int16_t* src, uint8_t* dst, int count)
+{
+    int i = 0;
+
+    // Sixteen samples in, sixteen bytes out: every store lands on bytes that
+    // have already been read, which keeps the in-place case safe.
+    for (; i + 16 <= count; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + i + 8));
+
+        __m128i lo = _mm_packs_epi32(ENCODE(_mm_srai_epi32(_mm_unpacklo_epi16(a, a), 16)),
+                                     ENCODE(_mm_srai_epi32(_mm_unpackhi_epi16(a, a), 16)));
+        __m128i hi = _mm_packs_epi32(ENCODE(_mm_srai_epi32(_mm_unpacklo_epi16(b, b), 16)),
+                                     ENCODE(_mm_srai_epi32(_mm_unpackhi_epi16(b, b), 16)));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+    }
+
+    return i;
+}
+
+#endif
+
+void g711_encode(enum G711Law law, const int16_t* src, uint8_t* dst, int count)
+{
+    int i = 0;
+
+    if (law == G711_ULAW) {
+#if G711_SSE2
+        i = encode_sse2<ulaw4>(src, dst, count);
+#endif
+        for (; i < count; i++)
+            dst[i] = encode_ulaw(src[i]);
+    }
+    else if (law == G711_ALAW) {
+#if G711_SSE2
+        i = encode_sse2<alaw4>(src, dst, count);
+#endif
+        for (; i < count; i++)
+            dst[i] = encode_alaw(src[i]);
+    }
+}
+
+uint8_t g711_silence(enum G711Law law)
+{
+    return law == G711_ALAW ? encode_alaw(0) : encode_ulaw(0);
+}
+
+enum G711Law g711_parse(const char* name)
+{
+    if (!strcmp(name, "mulaw") || !strcmp(name, "ulaw"))
+        return G711_ULAW;
+    if (!strcmp(name, "alaw"))
+        return G711_ALAW;
+    return G711_NONE;
+}
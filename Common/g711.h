@@ -0,0 +1,23 @@
+// g711.h : G.711 mu-law and A-law encoding of 16-bit samples.
+//
+
+#pragma once
+
+#include <cstdint>
+
+enum G711Law {
+    G711_NONE,      // linear PCM, no companding
+    G711_ULAW,      // WAVE_FORMAT_MULAW
+    G711_ALAW,      // WAVE_FORMAT_ALAW
+};
+
+// Encodes count samples to one byte each, bit-exact with the ITU reference
+// (Sun g711.c). dst may be the same memory as src, so a buffer of s16 can be
+// companded in place.
+void g711_encode(enum G711Law law, const int16_t* src, uint8_t* dst, int count);
+
+// Code of a zero sample, for filling gaps.
+uint8_t g711_silence(enum G711Law law);
+
+// Parses mulaw (or ulaw) and alaw. Returns G711_NONE for anything else.
+enum G711Law g711_parse(const char* name);
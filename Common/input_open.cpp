@@ -0,0 +1,123 @@
+// input_open.cpp : Format hinting and the decision whether stream info has to be probed.
+//
+
+#include "input_open.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include "compat.h"
+
+extern "C" {
+#include <libavutil/dict.h>
+}
+
+// Enough for every audio container's magic, including ID3v2-tagged MP3s whose
+// frame sync comes after a short tag.
+#define FAST_OPEN_MAGIC_SIZE 4096
+
+void input_options_init(InputOptions* options)
+{
+    options->fast = 0;
+    options->formatHint = NULL;
+}
+
+// Guesses the demuxer from the first bytes and the extension the way
+// avformat_open_input() would, only with a much smaller read.
+static const AVInputFormat* guess_format(const char* filename)
+{
+    uint8_t buf[FAST_OPEN_MAGIC_SIZE + AVPROBE_PADDING_SIZE] = {};
+    AVProbeData pd = {};
+    FILE* f;
+    int score = 0;
+
+    if (fopen_s(&f, filename, "rb") != 0)
+        return NULL;
+    pd.buf_size = (int)fread(buf, 1, FAST_OPEN_MAGIC_SIZE, f);
+    fclose(f);
+
+    pd.filename = filename;
+    pd.buf = buf;
+    const AVInputFormat* fmt = av_probe_input_format3(&pd, 1, &score);
+
+    return score >= AVPROBE_SCORE_EXTENSION ? fmt : NULL;
+}
+
+int input_open_file(AVFormatContext** format, const char* filename, const InputOptions* options)
+{
+    const AVInputFormat* fmt = NULL;
+    AVDictionary* opts = NULL;
+    int is_stdin = !strcmp(filename, "-");
+    int fast = is_stdin || (options && options->fast);
+
+    if (options && options->formatHint) {
+        fmt = av_find_input_format(options->formatHint);
+        if (!fmt)
+            fprintf(stderr, "Unknown input format '%s', probing instead\n", options->formatHint);
+    }
+    if (fast) {
+        if (!fmt && !is_stdin)
+            fmt = guess_format(filename);
+        av_dict_set_int(&opts, "probesize", FAST_OPEN_PROBESIZE, 0);
+        av_dict_set_int(&opts, "analyzeduration", FAST_OPEN_ANALYZEDURATION, 0);
+    }
+
+    int ret = avformat_open_input(format, is_stdin ? "pipe:0" : filename, (AVInputFormat*)fmt, &opts);
+    av_dict_free(&opts);
+    if (ret < 0)
+        fprintf(stderr, "Could not open file '%s'\n", filename);
+
+    return ret;
+}
+
+// Frame-based codecs whose every frame header carries the rate and channel
+// count; their decoders need nothing from the container.
+static int codec_is_self_describing(enum AVCodecID codec_id)
+{
+    return codec_id == AV_CODEC_ID_MP3 || codec_id == AV_CODEC_ID_MP2 ||
+           codec_id == AV_CODEC_ID_MP1 || codec_id == AV_CODEC_ID_AAC ||
+           codec_id == AV_CODEC_ID_AC3 || codec_id == AV_CODEC_ID_EAC3;
+}
+
+static int stream_is_described(const AVCodecParameters* params)
+{
+    if (params->codec_id == AV_CODEC_ID_NONE)
+        return 0;
+    if (params->sample_rate > 0 && params->channels > 0)
+        return 1;
+
+    // Raw ADTS AAC needs no extradata, AAC in MP4 does and always has a rate.
+    return codec_is_self_describing(params->codec_id);
+}
+
+static int first_audio_stream(AVFormatContext* format)
+{
+    for (unsigned int i = 0; i < format->nb_streams; i++) {
+        if (format->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO)
+            return (int)i;
+    }
+    return -1;
+}
+
+int input_find_audio_stream(AVFormatContext* format, const char* name, const InputOptions* options)
+{
+    int stream_index = first_audio_stream(format);
+
+    // Demuxers without a header (AVFMTCTX_NOHEADER) add their streams while
+    // probing, so an empty list always means probing.
+    if (!options || !options->fast || stream_index < 0 ||
+        !stream_is_described(format->streams[stream_index]->codecpar)) {
+        if (avformat_find_stream_info(format, NULL) < 0) {
+            fprintf(stderr, "Could not retrieve stream info from file '%s'\n", name);
+            return AVERROR_INVALIDDATA;
+        }
+        stream_index = first_audio_stream(format);
+    }
+
+    if (stream_index < 0) {
+        fprintf(stderr, "Could not retrieve audio stream from file '%s'\n", name);
+        return AVERROR_STREAM_NOT_FOUND;
+    }
+
+    return stream_index;
+}
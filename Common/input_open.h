@@ -0,0 +1,35 @@
+// input_open.h : Opens a demuxer on a file and finds its audio stream, optionally with bounded probing.
+//
+
+#pragma once
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+// Probing limits of the fast mode, against FFmpeg's 5 MB / 5 s defaults.
+#define FAST_OPEN_PROBESIZE 32768
+#define FAST_OPEN_ANALYZEDURATION 500000
+
+typedef struct INPUT_OPTIONS {
+    // Bounds probesize/analyzeduration and skips avformat_find_stream_info()
+    // when the demuxer header already describes the audio stream.
+    int fast;
+
+    // Demuxer short name ("mp3", "mov", "wav", ...). NULL lets the fast mode
+    // infer it from the first bytes and the extension.
+    const char* formatHint;
+} InputOptions;
+
+void input_options_init(InputOptions* options);
+
+// avformat_open_input() with options applied. filename "-" reads standard input
+// through FFmpeg's pipe protocol and always uses the fast probing limits, so
+// output starts after a few frames rather than seconds of buffered input.
+// Returns 0 or a negative AVERROR.
+int input_open_file(AVFormatContext** format, const char* filename, const InputOptions* options);
+
+// Returns the index of the first audio stream, running avformat_find_stream_info()
+// first unless the fast mode can do without it. options may be NULL.
+// Returns a negative AVERROR when there is no usable audio stream.
+int input_find_audio_stream(AVFormatContext* format, const char* name, const InputOptions* options);
@@ -0,0 +1,126 @@
+// mapped_reader.cpp : Windowed mmap/MapViewOfFile reader with read-ahead hints.
+//
+
+#include "mapped_reader.h"
+
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+extern "C" {
+#include <libavutil/error.h>
+}
+
+static void unmap_view(MappedReader* reader)
+{
+    if (!reader->view)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(reader->view);
+#else
+    munmap(reader->view, reader->view_size);
+#endif
+    reader->view = NULL;
+    reader->view_size = 0;
+}
+
+static int map_view(MappedReader* reader, int64_t offset)
+{
+    int64_t view_offset = offset - offset % (int64_t)reader->granularity;
+    size_t view_size = reader->window_size;
+    if ((int64_t)view_size > reader->end - view_offset)
+        view_size = (size_t)(reader->end - view_offset);
+
+    unmap_view(reader);
+
+#ifdef _WIN32
+    void* view = MapViewOfFile((HANDLE)reader->mapping, FILE_MAP_READ,
+                               (DWORD)(view_offset >> 32), (DWORD)view_offset, view_size);
+    if (!view)
+        return AVERROR(EIO);
+#else
+    void* view = mmap(NULL, view_size, PROT_READ, MAP_PRIVATE, reader->fd, view_offset);
+    if (view == MAP_FAILED)
+        return AVERROR(errno);
+    madvise(view, view_size, MADV_SEQUENTIAL);
+#endif
+
+    reader->view = (uint8_t*)view;
+    reader->view_offset = view_offset;
+    reader->view_size = view_size;
+    return 0;
+}
+
+int mapped_reader_open(MappedReader* reader, FILE* file, int64_t offset, uint64_t size)
+{
+    memset(reader, 0, sizeof(*reader));
+    reader->pos = offset;
+    reader->end = offset + (int64_t)size;
+
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    reader->granularity = info.dwAllocationGranularity;
+
+    HANDLE handle = (HANDLE)_get_osfhandle(_fileno(file));
+    reader->mapping = CreateFileMappingW(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!reader->mapping) {
+        fprintf(stderr, "Could not map input file\n");
+        return AVERROR(EIO);
+    }
+#else
+    reader->granularity = (size_t)sysconf(_SC_PAGESIZE);
+    reader->fd = fileno(file);
+#endif
+
+    reader->window_size = MAPPED_WINDOW_SIZE;
+    return 0;
+}
+
+const uint8_t* mapped_reader_next(MappedReader* reader, size_t want, size_t* got)
+{
+    *got = 0;
+    if (reader->pos >= reader->end)
+        return NULL;
+
+    if ((int64_t)want > reader->end - reader->pos)
+        want = (size_t)(reader->end - reader->pos);
+
+    // Remap when the request runs past the current window. Every window starts at
+    // the granularity boundary below pos and is at least one granule plus want long.
+    if (!reader->view || reader->pos + (int64_t)want > reader->view_offset + (int64_t)reader->view_size) {
+        if (reader->window_size < want + reader->granularity)
+            reader->window_size = want + reader->granularity;
+        if (map_view(reader, reader->pos) < 0) {
+            fprintf(stderr, "Could not map input window\n");
+            return NULL;
+        }
+    }
+
+    const uint8_t* data = reader->view + (reader->pos - reader->view_offset);
+    reader->pos += want;
+    *got = want;
+    return data;
+}
+
+void mapped_reader_close(MappedReader* reader)
+{
+    unmap_view(reader);
+
+#ifdef _WIN32
+    if (reader->mapping)
+        CloseHandle((HANDLE)reader->mapping);
+    reader->mapping = NULL;
+#endif
+}
@@ -0,0 +1,40 @@
+// mapped_reader.h : Sequential reader over a memory-mapped byte range of a file.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+// Bytes mapped at a time. Consumed windows are unmapped as the reader moves on,
+// so the address space used stays bounded whatever the file size.
+#define MAPPED_WINDOW_SIZE (64 * 1024 * 1024)
+
+typedef struct MAPPED_READER {
+#ifdef _WIN32
+    void* mapping;
+#else
+    int fd;
+#endif
+    size_t granularity;
+    size_t window_size;
+
+    int64_t pos;
+    int64_t end;
+
+    uint8_t* view;
+    int64_t view_offset;
+    size_t view_size;
+} MappedReader;
+
+// Maps size bytes of file starting at offset. The FILE* must stay open until
+// mapped_reader_close(). Returns 0 or a negative AVERROR.
+int mapped_reader_open(MappedReader* reader, FILE* file, int64_t offset, uint64_t size);
+
+// Returns a pointer to the next *got bytes (at most want, less only at the end of
+// the range) and advances past them. The pointer stays valid until the next call.
+// Returns NULL with *got 0 at the end, or on a mapping error.
+const uint8_t* mapped_reader_next(MappedReader* reader, size_t want, size_t* got);
+
+void mapped_reader_close(MappedReader* reader);
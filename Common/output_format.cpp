@@ -0,0 +1,126 @@
+// output_format.cpp : Output format parsing and the WAV header derived from it.
+//
+
+#include "output_format.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+extern "C" {
+#include <libavutil/avutil.h>
+#include <libavutil/error.h>
+#include <libavutil/mathematics.h>
+}
+
+#define WRITE_U32(buf, x) *(buf)     = (unsigned char)((x)&0xff);\
+                          *((buf)+1) = (unsigned char)(((x)>>8)&0xff);\
+                          *((buf)+2) = (unsigned char)(((x)>>16)&0xff);\
+                          *((buf)+3) = (unsigned char)(((x)>>24)&0xff);
+#define WRITE_U16(buf, x) *(buf)     = (unsigned char)((x)&0xff);\
+                          *((buf)+1) = (unsigned char)(((x)>>8)&0xff);
+
+void output_format_init(OutputFormat* format)
+{
+    format->sampleRate = OUT_SAMPLE_RATE;
+    format->channelLayout = OUT_CH_LAYOUT;
+    format->sampleFmt = OUT_SAMPLE_FMT;
+    format->law = G711_NONE;
+}
+
+int output_format_parse(OutputFormat* format, const char* rate, const char* layout, const char* sample_fmt)
+{
+    if (rate) {
+        int value = atoi(rate);
+        if (value <= 0) {
+            fprintf(stderr, "Invalid sample rate '%s'\n", rate);
+            return AVERROR(EINVAL);
+        }
+        format->sampleRate = value;
+    }
+
+    if (layout) {
+        uint64_t value = av_get_channel_layout(layout);
+        if (!value) {
+            fprintf(stderr, "Invalid channel layout '%s'\n", layout);
+            return AVERROR(EINVAL);
+        }
+        format->channelLayout = (int64_t)value;
+    }
+
+    if (sample_fmt && g711_parse(sample_fmt) != G711_NONE) {
+        format->sampleFmt = AV_SAMPLE_FMT_S16;
+        format->law = g711_parse(sample_fmt);
+    }
+    else if (sample_fmt) {
+        enum AVSampleFormat value = av_get_packed_sample_fmt(av_get_sample_fmt(sample_fmt));
+        if (value != AV_SAMPLE_FMT_U8 && value != AV_SAMPLE_FMT_S16 &&
+            value != AV_SAMPLE_FMT_S32 && value != AV_SAMPLE_FMT_FLT) {
+            fprintf(stderr, "Unsupported sample format '%s'\n", sample_fmt);
+            return AVERROR(EINVAL);
+        }
+        format->sampleFmt = value;
+        format->law = G711_NONE;
+    }
+
+    return 0;
+}
+
+int output_format_channels(const OutputFormat* format)
+{
+    return av_get_channel_layout_nb_channels(format->channelLayout);
+}
+
+int output_format_block_align(const OutputFormat* format)
+{
+    return output_format_channels(format) * output_format_bits(format) / 8;
+}
+
+int output_format_wav_tag(const OutputFormat* format)
+{
+    switch (format->law) {
+    case G711_ULAW: return 7;
+    case G711_ALAW: return 6;
+    default:        return format->sampleFmt == AV_SAMPLE_FMT_FLT ? 3 : 1;
+    }
+}
+
+int output_format_bits(const OutputFormat* format)
+{
+    return format->law != G711_NONE ? 8 : av_get_bytes_per_sample(format->sampleFmt) * 8;
+}
+
+int64_t output_format_data_size(const OutputFormat* format, int64_t duration)
+{
+    if (duration == AV_NOPTS_VALUE || duration <= 0)
+        return 0;
+
+    int64_t frames = av_rescale(duration, format->sampleRate, AV_TIME_BASE);
+    return frames * output_format_block_align(format);
+}
+
+void output_format_wav_header(const OutputFormat* format, unsigned char* headbuf, uint32_t data_size)
+{
+    int channels = output_format_channels(format);
+    int samplesize = output_format_bits(format);
+    int align = output_format_block_align(format);
+    int bytespersec = format->sampleRate * align;
+    int tag = output_format_wav_tag(format);
+
+    // The pad byte after an odd data chunk counts towards the RIFF size.
+    uint32_t riff_size = data_size == WAV_STREAMING_SIZE ? WAV_STREAMING_SIZE : data_size + (data_size & 1) + WAV_HEADER_SIZE - 8;
+
+    memcpy(headbuf, "RIFF", 4);
+    WRITE_U32(headbuf + 4, riff_size);
+    memcpy(headbuf + 8, "WAVE", 4);
+    memcpy(headbuf + 12, "fmt ", 4);
+    WRITE_U32(headbuf + 16, 16);
+    WRITE_U16(headbuf + 20, tag);  /* format */
+    WRITE_U16(headbuf + 22, channels);
+    WRITE_U32(headbuf + 24, format->sampleRate);
+    WRITE_U32(headbuf + 28, bytespersec);
+    WRITE_U16(headbuf + 32, align);
+    WRITE_U16(headbuf + 34, samplesize);
+    memcpy(headbuf + 36, "data", 4);
+    WRITE_U32(headbuf + 40, data_size);
+}
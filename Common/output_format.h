@@ -0,0 +1,59 @@
+// output_format.h : Format of the converted audio.
+//
+
+#pragma once
+
+#include <cstdint>
+
+#include "g711.h"
+
+extern "C" {
+#include <libavutil/channel_layout.h>
+#include <libavutil/samplefmt.h>
+}
+
+// Default output: 8 kHz mono 16-bit PCM for telephony.
+#define OUT_SAMPLE_RATE 8000
+#define OUT_CH_LAYOUT AV_CH_LAYOUT_MONO
+#define OUT_SAMPLE_FMT AV_SAMPLE_FMT_S16
+
+#define WAV_HEADER_SIZE 44
+
+// Size of a data chunk whose length is not known when the header goes out, by
+// the streaming WAV convention; the RIFF size is set to the same value.
+#define WAV_STREAMING_SIZE 0xFFFFFFFFu
+
+typedef struct OUTPUT_FORMAT {
+    int sampleRate;
+    int64_t channelLayout;
+    // Always packed (interleaved), as stored in the WAV data chunk. s16 under
+    // G.711, which stores one companded byte per sample instead.
+    enum AVSampleFormat sampleFmt;
+    enum G711Law law;
+} OutputFormat;
+
+void output_format_init(OutputFormat* format);
+
+// Fills format from command line style strings, any of which may be NULL to
+// keep the current value: rate in Hz, a layout name or channel count understood
+// by av_get_channel_layout() ("mono", "stereo", "2") and a sample format name
+// (u8, s16, s32, flt, or mulaw and alaw for G.711). Returns 0 or a negative AVERROR.
+int output_format_parse(OutputFormat* format, const char* rate, const char* layout, const char* sample_fmt);
+
+int output_format_channels(const OutputFormat* format);
+
+// Bytes per interleaved sample frame (all channels).
+int output_format_block_align(const OutputFormat* format);
+
+// wFormatTag and wBitsPerSample of the WAV fmt chunk.
+int output_format_wav_tag(const OutputFormat* format);
+int output_format_bits(const OutputFormat* format);
+
+// Expected size of the sample data for duration in AV_TIME_BASE units, or 0
+// when the duration is unknown (AV_NOPTS_VALUE or not positive).
+int64_t output_format_data_size(const OutputFormat* format, int64_t duration);
+
+// Builds the canonical 44-byte RIFF/WAVE header for data_size bytes of samples,
+// or for a stream of unknown length when data_size is WAV_STREAMING_SIZE.
+// Linear PCM only; G.711 needs the longer header of wav_header.h.
+void output_format_wav_header(const OutputFormat* format, unsigned char* headbuf, uint32_t data_size);
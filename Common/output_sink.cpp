@@ -0,0 +1,144 @@
+// output_sink.cpp : File, memory and callback implementations of OutputSink.
+//
+
+#include "output_sink.h"
+
+#include <cstring>
+
+#include "compat.h"
+
+extern "C" {
+#include <libavutil/error.h>
+#include <libavutil/mem.h>
+}
+
+#define OUTPUT_BUFFER_MIN_SIZE 65536
+
+void output_sink_init_file(OutputSink* sink, FILE* file)
+{
+    memset(sink, 0, sizeof(*sink));
+    sink->type = OUTPUT_SINK_FILE;
+    sink->file = file;
+    // Pipes have no position; nothing is ever written back into them.
+    sink->pos = ftell64(file);
+    if (sink->pos < 0)
+        sink->pos = 0;
+}
+
+void output_sink_init_buffer(OutputSink* sink, uint8_t* data, size_t capacity)
+{
+    memset(sink, 0, sizeof(*sink));
+    sink->type = OUTPUT_SINK_BUFFER;
+    sink->data = data;
+    sink->capacity = data ? capacity : 0;
+    sink->growable = data == NULL;
+}
+
+void output_sink_init_callback(OutputSink* sink, OutputWriteFunc write, void* opaque)
+{
+    memset(sink, 0, sizeof(*sink));
+    sink->type = OUTPUT_SINK_CALLBACK;
+    sink->write = write;
+    sink->opaque = opaque;
+}
+
+void output_sink_init_writer(OutputSink* sink, FileWriter* writer)
+{
+    memset(sink, 0, sizeof(*sink));
+    sink->type = OUTPUT_SINK_WRITER;
+    sink->writer = writer;
+    sink->pos = writer->end;
+}
+
+static int reserve_buffer(OutputSink* sink, size_t needed)
+{
+    if (needed <= sink->capacity)
+        return 0;
+    if (!sink->growable)
+        return AVERROR(ENOSPC);
+
+    size_t capacity = sink->capacity ? sink->capacity : OUTPUT_BUFFER_MIN_SIZE;
+    while (capacity < needed)
+        capacity *= 2;
+
+    uint8_t* data = (uint8_t*)av_realloc(sink->data, capacity);
+    if (!data)
+        return AVERROR(ENOMEM);
+
+    sink->data = data;
+    sink->capacity = capacity;
+    return 0;
+}
+
+static int write_buffer(OutputSink* sink, int64_t offset, const uint8_t* buf, size_t size)
+{
+    size_t end = (size_t)offset + size;
+    int ret = reserve_buffer(sink, end);
+
+    if (ret == 0)
+        memcpy(sink->data + offset, buf, size);
+    else if (ret != AVERROR(ENOSPC))
+        return ret;
+
+    if (end > sink->size)
+        sink->size = end;
+    return (int)size;
+}
+
+int output_sink_write(OutputSink* sink, const uint8_t* buf, size_t size)
+{
+    int ret;
+
+    switch (sink->type) {
+    case OUTPUT_SINK_FILE:
+        ret = fwrite(buf, 1, size, sink->file) == size ? (int)size : AVERROR(EIO);
+        break;
+    case OUTPUT_SINK_BUFFER:
+        ret = write_buffer(sink, sink->pos, buf, size);
+        break;
+    case OUTPUT_SINK_CALLBACK:
+        ret = sink->write(sink->opaque, sink->pos, buf, (int)size) == (int)size ? (int)size : AVERROR(EIO);
+        break;
+    case OUTPUT_SINK_WRITER:
+        ret = file_writer_write(sink->writer, buf, size);
+        break;
+    default:
+        ret = AVERROR(EINVAL);
+    }
+
+    if (ret < 0) {
+        fprintf(stderr, "ERROR: Failed to write output\n");
+        sink->failed = 1;
+        return ret;
+    }
+
+    sink->pos += size;
+    return ret;
+}
+
+int output_sink_write_at(OutputSink* sink, int64_t offset, const uint8_t* buf, size_t size)
+{
+    switch (sink->type) {
+    case OUTPUT_SINK_FILE:
+        if (fseek64(sink->file, offset, SEEK_SET) != 0) {
+            fprintf(stderr, "ERROR: Failed to seek on seekable file: \n");
+            return AVERROR(EIO);
+        }
+        if (fwrite(buf, 1, size, sink->file) != size || fseek64(sink->file, sink->pos, SEEK_SET) != 0)
+            return AVERROR(EIO);
+        return (int)size;
+    case OUTPUT_SINK_BUFFER:
+        return write_buffer(sink, offset, buf, size);
+    case OUTPUT_SINK_CALLBACK:
+        return sink->write(sink->opaque, offset, buf, (int)size) == (int)size ? (int)size : AVERROR(EIO);
+    case OUTPUT_SINK_WRITER:
+        return file_writer_write_at(sink->writer, offset, buf, size);
+    }
+
+    return AVERROR(EINVAL);
+}
+
+int output_sink_overflowed(const OutputSink* sink)
+{
+    return sink->type == OUTPUT_SINK_BUFFER && sink->size > sink->capacity;
+}
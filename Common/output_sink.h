@@ -0,0 +1,63 @@
+// output_sink.h : Destination for converted audio: a FILE*, a memory buffer or a write callback.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#include "file_writer.h"
+
+// Positioned write: offset is where buf goes in the output. Data arrives in order,
+// the only backwards write is the final WAV header at offset 0.
+// Returns the number of bytes consumed, anything else aborts the conversion.
+typedef int (*OutputWriteFunc)(void* opaque, int64_t offset, const uint8_t* buf, int size);
+
+enum OutputSinkType {
+    OUTPUT_SINK_FILE,
+    OUTPUT_SINK_BUFFER,
+    OUTPUT_SINK_CALLBACK,
+    OUTPUT_SINK_WRITER,
+};
+
+typedef struct OUTPUT_SINK {
+    enum OutputSinkType type;
+    int64_t pos;
+    // Set by the first failed append; the conversion should stop there.
+    int failed;
+
+    FILE* file;
+
+    // Memory output. size keeps counting past capacity on a fixed buffer so the
+    // caller learns how much room the result needs.
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+    int growable;
+
+    OutputWriteFunc write;
+    void* opaque;
+
+    FileWriter* writer;
+} OutputSink;
+
+void output_sink_init_file(OutputSink* sink, FILE* file);
+
+// data NULL makes the sink allocate and grow its own buffer (free with av_free()).
+void output_sink_init_buffer(OutputSink* sink, uint8_t* data, size_t capacity);
+
+void output_sink_init_callback(OutputSink* sink, OutputWriteFunc write, void* opaque);
+
+// writer stays owned by the caller, who closes it after the conversion.
+void output_sink_init_writer(OutputSink* sink, FileWriter* writer);
+
+// Appends size bytes. Returns size or a negative AVERROR, and marks the sink
+// failed on error.
+int output_sink_write(OutputSink* sink, const uint8_t* buf, size_t size);
+
+// Overwrites already written bytes at offset, used to patch headers.
+int output_sink_write_at(OutputSink* sink, int64_t offset, const uint8_t* buf, size_t size);
+
+// True when a fixed caller buffer was too small for everything written.
+int output_sink_overflowed(const OutputSink* sink);
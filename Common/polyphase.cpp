@@ -0,0 +1,530 @@
+// polyphase.cpp : Filter banks, input loading with the downmix, output conversion and kernel dispatch.
+//
+
+#include "polyphase.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#include "polyphase_filter.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+extern "C" {
+#include <libavutil/error.h>
+#include <libavutil/mem.h>
+}
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define POLYPHASE_X86 1
+#else
+#define POLYPHASE_X86 0
+#endif
+
+// Centre of the transition band as a fraction of the output Nyquist frequency.
+// At the filter lengths of polyphase_taps() the band is about 1 kHz wide at
+// 8 kHz output, so the telephone band up to 3.4 kHz stays flat and whatever
+// aliases from just above Nyquist folds back above 3.6 kHz.
+#define POLYPHASE_CUTOFF 0.975
+
+// Kaiser window beta, about 85 dB of stopband attenuation.
+#define POLYPHASE_KAISER_BETA 8.6
+
+#define POLYPHASE_PI 3.14159265358979323846
+
+typedef struct POLYPHASE_RATIO_INFO {
+    int inRate;
+    int outRate;
+    int l;
+    int m;
+    int taps;
+} PolyphaseRatioInfo;
+
+#define POLYPHASE_RATIO_INFO(in_rate, out_rate)                                                 \
+    { in_rate, out_rate, PolyphaseRatio<in_rate, out_rate>::L, PolyphaseRatio<in_rate, out_rate>::M, \
+      PolyphaseRatio<in_rate, out_rate>::TAPS },
+
+static const PolyphaseRatioInfo ratios[] = { POLYPHASE_RATIOS(POLYPHASE_RATIO_INFO) };
+
+#define RATIO_COUNT ((int)(sizeof(ratios) / sizeof(ratios[0])))
+
+struct POLYPHASE_RESAMPLER {
+    const PolyphaseRatioInfo* ratio;
+    const float* coeffs;
+    PolyphaseFilterFunc filter;
+
+    int inChannels;
+    enum AVSampleFormat inFmt;
+    int outChannels;
+    enum AVSampleFormat outFmt;
+
+    // Float input per output channel, after the downmix. Starts with
+    // TAPS / 2 - 1 samples of silence so output 0 lies on input sample 0.
+    float* history[POLYPHASE_MAX_CHANNELS];
+    int length;
+    int capacity;
+
+    // Window start in history and filter phase of the next output sample.
+    int idx;
+    int phase;
+
+    int64_t consumed;
+    int64_t produced;
+    int flushed;
+
+    // Filter output per channel, before conversion and interleaving.
+    float* staging[POLYPHASE_MAX_CHANNELS];
+    int stagingSize;
+};
+
+struct DotScalar {
+    template <int TAPS>
+    static inline float dot(const float* h, const float* x)
+    {
+        float acc0 = 0, acc1 = 0, acc2 = 0, acc3 = 0;
+
+        for (int k = 0; k < TAPS; k += 4) {
+            acc0 += h[k] * x[k];
+            acc1 += h[k + 1] * x[k + 1];
+            acc2 += h[k + 2] * x[k + 2];
+            acc3 += h[k + 3] * x[k + 3];
+        }
+        return (acc0 + acc1) + (acc2 + acc3);
+    }
+};
+
+#define POLYPHASE_DOT DotScalar
+
+const PolyphaseFilterFunc* polyphase_filters_scalar(void)
+{
+    static const PolyphaseFilterFunc filters[] = { POLYPHASE_RATIOS(POLYPHASE_FILTER_ENTRY) };
+    return filters;
+}
+
+static double bessel_i0(double x)
+{
+    double sum = 1, term = 1;
+
+    for (int k = 1; k < 64 && term > sum * 1e-17; k++) {
+        double half = x / (2.0 * k);
+        term *= half * half;
+        sum += term;
+    }
+    return sum;
+}
+
+// Kaiser-windowed sinc, one row of taps per output phase, each row normalised
+// to unity gain at DC.
+static float* build_bank(const PolyphaseRatioInfo* ratio)
+{
+    int taps = ratio->taps;
+    double fc = 0.5 * POLYPHASE_CUTOFF * std::min(1.0, (double)ratio->l / ratio->m);
+    double half = taps / 2.0;
+    double i0_beta = bessel_i0(POLYPHASE_KAISER_BETA);
+    std::vector<double> row(taps);
+
+    float* bank = (float*)av_malloc(sizeof(float) * taps * ratio->l);
+    if (!bank)
+        return NULL;
+
+    for (int p = 0; p < ratio->l; p++) {
+        double sum = 0;
+
+        for (int k = 0; k < taps; k++) {
+            double d = k - (taps / 2 - 1) - (double)p / ratio->l;
+            double x = d / half;
+            double window = fabs(x) < 1 ? bessel_i0(POLYPHASE_KAISER_BETA * sqrt(1 - x * x)) / i0_beta : 0;
+            double sinc = d == 0 ? 2 * fc : sin(2 * POLYPHASE_PI * fc * d) / (POLYPHASE_PI * d);
+
+            row[k] = sinc * window;
+            sum += row[k];
+        }
+        for (int k = 0; k < taps; k++)
+            bank[p * taps + k] = (float)(row[k] / sum);
+    }
+
+    return bank;
+}
+
+// Built on first use and kept for the life of the process.
+static const float* ratio_bank(int index)
+{
+    static float* banks[RATIO_COUNT];
+    static std::once_flag once[RATIO_COUNT];
+
+    std::call_once(once[index], [index]() { banks[index] = build_bank(&ratios[index]); });
+    return banks[index];
+}
+
+static int find_ratio(int in_rate, int out_rate)
+{
+    for (int i = 0; i < RATIO_COUNT; i++) {
+        if (ratios[i].inRate == in_rate && ratios[i].outRate == out_rate)
+            return i;
+    }
+    return -1;
+}
+
+static enum PolyphaseIsa detect_isa(void)
+{
+#if POLYPHASE_X86 && defined(_MSC_VER)
+    int info[4];
+
+    __cpuid(info, 0);
+    int max_leaf = info[0];
+    __cpuid(info, 1);
+    bool fma = (info[2] & (1 << 12)) != 0;
+    unsigned long long xcr0 = (info[2] & (1 << 27)) ? _xgetbv(0) : 0;
+
+    // The OS has to save the YMM (and for AVX-512 the ZMM and mask) state.
+    if (max_leaf >= 7) {
+        __cpuidex(info, 7, 0);
+        if ((info[1] & (1 << 16)) && (xcr0 & 0xe6) == 0xe6)
+            return POLYPHASE_ISA_AVX512;
+        if ((info[1] & (1 << 5)) && fma && (xcr0 & 0x6) == 0x6)
+            return POLYPHASE_ISA_AVX2;
+    }
+    return POLYPHASE_ISA_SSE2;
+#elif POLYPHASE_X86
+    // libgcc checks the OS state saving as well.
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return POLYPHASE_ISA_AVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return POLYPHASE_ISA_AVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return POLYPHASE_ISA_SSE2;
+    return POLYPHASE_ISA_SCALAR;
+#else
+    return POLYPHASE_ISA_SCALAR;
+#endif
+}
+
+static std::atomic<int> isa_limit(POLYPHASE_ISA_AVX512);
+
+enum PolyphaseIsa polyphase_isa(void)
+{
+    static const enum PolyphaseIsa detected = detect_isa();
+    return (enum PolyphaseIsa)std::min((int)detected, isa_limit.load());
+}
+
+void polyphase_limit_isa(enum PolyphaseIsa isa)
+{
+    isa_limit = isa;
+}
+
+static const char* const isa_names[] = { "scalar", "sse2", "avx2", "avx512" };
+
+const char* polyphase_isa_name(enum PolyphaseIsa isa)
+{
+    return isa_names[isa];
+}
+
+int polyphase_parse_isa(const char* name, enum PolyphaseIsa* isa)
+{
+    for (int i = 0; i <= POLYPHASE_ISA_AVX512; i++) {
+        if (!strcmp(name, isa_names[i])) {
+            *isa = (enum PolyphaseIsa)i;
+            return 0;
+        }
+    }
+
+    fprintf(stderr, "Unknown instruction set '%s'\n", name);
+    return AVERROR(EINVAL);
+}
+
+// Falls back to the next slower set when a kernel file was built for another
+// architecture.
+static PolyphaseFilterFunc select_filter(int index, enum PolyphaseIsa isa)
+{
+    const PolyphaseFilterFunc* filters = NULL;
+
+    switch (isa) {
+    case POLYPHASE_ISA_AVX512:
+        filters = polyphase_filters_avx512();
+        if (filters)
+            break;
+        // fall through
+    case POLYPHASE_ISA_AVX2:
+        filters = polyphase_filters_avx2();
+        if (filters)
+            break;
+        // fall through
+    case POLYPHASE_ISA_SSE2:
+        filters = polyphase_filters_sse2();
+        if (filters)
+            break;
+        // fall through
+    default:
+        filters = polyphase_filters_scalar();
+    }
+
+    return filters[index];
+}
+
+static int is_supported_fmt(enum AVSampleFormat fmt)
+{
+    return fmt == AV_SAMPLE_FMT_U8 || fmt == AV_SAMPLE_FMT_S16 ||
+           fmt == AV_SAMPLE_FMT_S32 || fmt == AV_SAMPLE_FMT_FLT;
+}
+
+int polyphase_supported(int in_rate, int in_channels, enum AVSampleFormat in_fmt,
+                        int out_rate, int out_channels, enum AVSampleFormat out_fmt)
+{
+    return find_ratio(in_rate, out_rate) >= 0 &&
+           in_channels >= 1 && in_channels <= POLYPHASE_MAX_CHANNELS &&
+           (out_channels == in_channels || (out_channels == 1 && in_channels == 2)) &&
+           is_supported_fmt(av_get_packed_sample_fmt(in_fmt)) &&
+           is_supported_fmt(out_fmt);
+}
+
+static int reserve_history(PolyphaseResampler* r, int needed)
+{
+    if (needed <= r->capacity)
+        return 0;
+
+    int capacity = std::max(needed, r->capacity * 2);
+    for (int ch = 0; ch < r->outChannels; ch++) {
+        float* history = (float*)av_realloc(r->history[ch], sizeof(float) * capacity);
+        if (!history)
+            return AVERROR(ENOMEM);
+        r->history[ch] = history;
+    }
+
+    r->capacity = capacity;
+    return 0;
+}
+
+static int reserve_staging(PolyphaseResampler* r, int count)
+{
+    if (count <= r->stagingSize)
+        return 0;
+
+    for (int ch = 0; ch < r->outChannels; ch++) {
+        av_freep(&r->staging[ch]);
+        r->staging[ch] = (float*)av_malloc(sizeof(float) * count);
+        if (!r->staging[ch]) {
+            r->stagingSize = 0;
+            return AVERROR(ENOMEM);
+        }
+    }
+
+    r->stagingSize = count;
+    return 0;
+}
+
+static inline float to_float(uint8_t v) { return (v - 128) * (1.0f / 128); }
+static inline float to_float(int16_t v) { return v * (1.0f / 32768); }
+static inline float to_float(int32_t v) { return (float)(v * (1.0 / 2147483648.0)); }
+static inline float to_float(float v) { return v; }
+
+// Converts count input samples to float at the end of history. For mono
+// output the two channels are averaged on the way, so the filter runs only once.
+template <typename T>
+static void load_input(PolyphaseResampler* r, const uint8_t** in, int count)
+{
+    int channels = r->inChannels;
+    int planar = av_sample_fmt_is_planar(r->inFmt);
+    int stride = planar ? 1 : channels;
+    const T* src[POLYPHASE_MAX_CHANNELS];
+
+    for (int c = 0; c < channels; c++)
+        src[c] = planar ? (const T*)in[c] : (const T*)in[0] + c;
+
+    if (r->outChannels == 1 && channels > 1) {
+        float* dst = r->history[0] + r->length;
+        float gain = 1.0f / channels;
+
+        for (int i = 0; i < count; i++) {
+            float sum = 0;
+            for (int c = 0; c < channels; c++)
+                sum += to_float(src[c][i * stride]);
+            dst[i] = sum * gain;
+        }
+        return;
+    }
+
+    for (int c = 0; c < channels; c++) {
+        float* dst = r->history[c] + r->length;
+        for (int i = 0; i < count; i++)
+            dst[i] = to_float(src[c][i * stride]);
+    }
+}
+
+static inline void from_float(float v, uint8_t* dst)
+{
+    *dst = (uint8_t)lrintf(std::min(std::max(v * 128 + 128, 0.0f), 255.0f));
+}
+
+static inline void from_float(float v, int16_t* dst)
+{
+    *dst = (int16_t)lrintf(std::min(std::max(v * 32768, -32768.0f), 32767.0f));
+}
+
+static inline void from_float(float v, int32_t* dst)
+{
+    *dst = (int32_t)llrint(std::min(std::max(v * 2147483648.0, -2147483648.0), 2147483647.0));
+}
+
+static inline void from_float(float v, float* dst)
+{
+    *dst = v;
+}
+
+// Interleaves the staged channels into packed output.
+template <typename T>
+static void store_output(const PolyphaseResampler* r, uint8_t* out, int count)
+{
+    T* dst = (T*)out;
+    int channels = r->outChannels;
+
+    for (int ch = 0; ch < channels; ch++) {
+        const float* src = r->staging[ch];
+        for (int n = 0; n < count; n++)
+            from_float(src[n], &dst[n * channels + ch]);
+    }
+}
+
+PolyphaseResampler* polyphase_alloc(int in_rate, int in_channels, enum AVSampleFormat in_fmt,
+                                    int out_rate, int out_channels, enum AVSampleFormat out_fmt)
+{
+    if (!polyphase_supported(in_rate, in_channels, in_fmt, out_rate, out_channels, out_fmt))
+        return NULL;
+
+    int index = find_ratio(in_rate, out_rate);
+    const float* coeffs = ratio_bank(index);
+    if (!coeffs)
+        return NULL;
+
+    PolyphaseResampler* r = (PolyphaseResampler*)av_mallocz(sizeof(PolyphaseResampler));
+    if (!r)
+        return NULL;
+
+    r->ratio = &ratios[index];
+    r->coeffs = coeffs;
+    r->filter = select_filter(index, polyphase_isa());
+    r->inChannels = in_channels;
+    r->inFmt = in_fmt;
+    r->outChannels = out_channels;
+    r->outFmt = out_fmt;
+
+    int lead = r->ratio->taps / 2 - 1;
+    if (reserve_history(r, 2 * r->ratio->taps) < 0) {
+        polyphase_free(&r);
+        return NULL;
+    }
+    for (int ch = 0; ch < out_channels; ch++)
+        memset(r->history[ch], 0, sizeof(float) * lead);
+    r->length = lead;
+
+    return r;
+}
+
+int polyphase_get_out_samples(PolyphaseResampler* r, int in_count)
+{
+    int64_t samples = (int64_t)r->length - r->idx + in_count + r->ratio->taps / 2;
+    return (int)(samples * r->ratio->l / r->ratio->m + 1);
+}
+
+// Output samples whose whole window is in history and, once drained, that lie
+// before the end of the input.
+static int available_output(const PolyphaseResampler* r)
+{
+    const PolyphaseRatioInfo* ratio = r->ratio;
+    int64_t room = (int64_t)r->length - ratio->taps - r->idx;
+    if (room < 0)
+        return 0;
+
+    int64_t count = ((room + 1) * ratio->l - r->phase + ratio->m - 1) / ratio->m;
+    if (r->flushed) {
+        int64_t left = r->consumed * ratio->l - r->produced * ratio->m;
+        count = std::min(count, left > 0 ? (left + ratio->m - 1) / ratio->m : 0);
+    }
+
+    return (int)std::min<int64_t>(count, INT32_MAX);
+}
+
+int polyphase_convert(PolyphaseResampler* r, uint8_t** out, int out_count, const uint8_t** in, int in_count)
+{
+    const PolyphaseRatioInfo* ratio = r->ratio;
+    int ret;
+
+    if (in && in_count > 0) {
+        ret = reserve_history(r, r->length + in_count);
+        if (ret < 0)
+            return ret;
+
+        switch (av_get_packed_sample_fmt(r->inFmt)) {
+        case AV_SAMPLE_FMT_U8:  load_input<uint8_t>(r, in, in_count); break;
+        case AV_SAMPLE_FMT_S16: load_input<int16_t>(r, in, in_count); break;
+        case AV_SAMPLE_FMT_S32: load_input<int32_t>(r, in, in_count); break;
+        default:                load_input<float>(r, in, in_count); break;
+        }
+        r->length += in_count;
+        r->consumed += in_count;
+    }
+    else if (!in && !r->flushed) {
+        // Silence past the end gives the last samples their right-hand taps.
+        int tail = ratio->taps / 2;
+        ret = reserve_history(r, r->length + tail);
+        if (ret < 0)
+            return ret;
+
+        for (int ch = 0; ch < r->outChannels; ch++)
+            memset(r->history[ch] + r->length, 0, sizeof(float) * tail);
+        r->length += tail;
+        r->flushed = 1;
+    }
+
+    int count = out_count > 0 ? std::min(out_count, available_output(r)) : 0;
+    if (count > 0) {
+        ret = reserve_staging(r, count);
+        if (ret < 0)
+            return ret;
+
+        for (int ch = 0; ch < r->outChannels; ch++)
+            r->filter(r->coeffs, r->history[ch], r->idx, r->phase, r->staging[ch], count);
+
+        switch (r->outFmt) {
+        case AV_SAMPLE_FMT_U8:  store_output<uint8_t>(r, out[0], count); break;
+        case AV_SAMPLE_FMT_S16: store_output<int16_t>(r, out[0], count); break;
+        case AV_SAMPLE_FMT_S32: store_output<int32_t>(r, out[0], count); break;
+        default:                store_output<float>(r, out[0], count); break;
+        }
+
+        int64_t step = r->phase + (int64_t)count * ratio->m;
+        r->idx += (int)(step / ratio->l);
+        r->phase = (int)(step % ratio->l);
+        r->produced += count;
+    }
+
+    // Drop what no later window reaches.
+    if (r->idx > 0) {
+        for (int ch = 0; ch < r->outChannels; ch++)
+            memmove(r->history[ch], r->history[ch] + r->idx, sizeof(float) * (r->length - r->idx));
+        r->length -= r->idx;
+        r->idx = 0;
+    }
+
+    return count;
+}
+
+void polyphase_free(PolyphaseResampler** resampler)
+{
+    PolyphaseResampler* r = *resampler;
+    if (!r)
+        return;
+
+    for (int ch = 0; ch < POLYPHASE_MAX_CHANNELS; ch++) {
+        av_free(r->history[ch]);
+        av_free(r->staging[ch]);
+    }
+    av_freep(resampler);
+}
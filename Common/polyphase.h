@@ -0,0 +1,57 @@
+// polyphase.h : Native polyphase resampler for the telephony rate pairs, SIMD kernels picked at runtime.
+//
+
+#pragma once
+
+#include <cstdint>
+
+extern "C" {
+#include <libavutil/samplefmt.h>
+}
+
+#define POLYPHASE_MAX_CHANNELS 8
+
+// Kernel sets from slowest to fastest.
+enum PolyphaseIsa {
+    POLYPHASE_ISA_SCALAR,
+    POLYPHASE_ISA_SSE2,
+    POLYPHASE_ISA_AVX2,
+    POLYPHASE_ISA_AVX512,
+};
+
+typedef struct POLYPHASE_RESAMPLER PolyphaseResampler;
+
+// True when polyphase_alloc() takes the conversion: 44.1, 48 or 16 kHz to 8 kHz,
+// u8/s16/s32/flt input packed or planar, and output of the same channel count,
+// or mono from stereo (both channels at half gain while the input is loaded,
+// before the filter), in packed u8/s16/s32/flt.
+int polyphase_supported(int in_rate, int in_channels, enum AVSampleFormat in_fmt,
+                        int out_rate, int out_channels, enum AVSampleFormat out_fmt);
+
+// Returns NULL when the conversion is not supported or memory runs out.
+PolyphaseResampler* polyphase_alloc(int in_rate, int in_channels, enum AVSampleFormat in_fmt,
+                                    int out_rate, int out_channels, enum AVSampleFormat out_fmt);
+
+// Same contract as swr_get_out_samples(): an upper bound on what the next
+// polyphase_convert() with in_count input samples can return.
+int polyphase_get_out_samples(PolyphaseResampler* resampler, int in_count);
+
+// Same contract as swr_convert(): converts in_count samples from in, writes at
+// most out_count to out[0] and buffers the rest. NULL in drains the filter;
+// call again until it returns 0. Output sample n lies on input position
+// n * in_rate / out_rate, like swr's. Returns the samples written or a
+// negative AVERROR.
+int polyphase_convert(PolyphaseResampler* resampler, uint8_t** out, int out_count, const uint8_t** in, int in_count);
+
+void polyphase_free(PolyphaseResampler** resampler);
+
+// Best kernel set the CPU and OS support, capped by polyphase_limit_isa().
+enum PolyphaseIsa polyphase_isa(void);
+
+// Caps the kernels of resamplers allocated afterwards, for benchmarks.
+void polyphase_limit_isa(enum PolyphaseIsa isa);
+
+const char* polyphase_isa_name(enum PolyphaseIsa isa);
+
+// Parses scalar, sse2, avx2 or avx512. Returns 0 or a negative AVERROR.
+int polyphase_parse_isa(const char* name, enum PolyphaseIsa* isa);
@@ -0,0 +1,52 @@
+// polyphase_avx2.cpp : AVX2/FMA filter kernels, only called after a CPUID check.
+//
+// Build this file with /arch:AVX2 (MSVC) or -mavx2 -mfma so the compiler emits
+// VEX code throughout; GCC picks the target up from the pragma otherwise.
+
+#if defined(__GNUC__) && !defined(__clang__) && !defined(__AVX2__)
+#pragma GCC target("avx2,fma")
+#endif
+
+#include "polyphase_filter.h"
+
+#include <cstddef>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+struct DotAvx2 {
+    template <int TAPS>
+    static inline float dot(const float* h, const float* x)
+    {
+        __m256 acc0 = _mm256_setzero_ps();
+        __m256 acc1 = _mm256_setzero_ps();
+
+        for (int k = 0; k < TAPS; k += 16) {
+            acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(h + k), _mm256_loadu_ps(x + k), acc0);
+            acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(h + k + 8), _mm256_loadu_ps(x + k + 8), acc1);
+        }
+
+        __m256 acc = _mm256_add_ps(acc0, acc1);
+        __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+        return _mm_cvtss_f32(sum);
+    }
+};
+
+#define POLYPHASE_DOT DotAvx2
+
+const PolyphaseFilterFunc* polyphase_filters_avx2(void)
+{
+    static const PolyphaseFilterFunc filters[] = { POLYPHASE_RATIOS(POLYPHASE_FILTER_ENTRY) };
+    return filters;
+}
+
+#else
+
+const PolyphaseFilterFunc* polyphase_filters_avx2(void)
+{
+    return NULL;
+}
+
+#endif
@@ -0,0 +1,45 @@
+// polyphase_avx512.cpp : AVX-512F filter kernels, only called after a CPUID check.
+//
+// Build this file with /arch:AVX512 (MSVC) or -mavx512f so the compiler emits
+// EVEX code throughout; GCC picks the target up from the pragma otherwise.
+
+#if defined(__GNUC__) && !defined(__clang__) && !defined(__AVX512F__)
+#pragma GCC target("avx512f")
+#endif
+
+#include "polyphase_filter.h"
+
+#include <cstddef>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#include <immintrin.h>
+
+struct DotAvx512 {
+    template <int TAPS>
+    static inline float dot(const float* h, const float* x)
+    {
+        __m512 acc = _mm512_setzero_ps();
+
+        for (int k = 0; k < TAPS; k += 16)
+            acc = _mm512_fmadd_ps(_mm512_loadu_ps(h + k), _mm512_loadu_ps(x + k), acc);
+
+        return _mm512_reduce_add_ps(acc);
+    }
+};
+
+#define POLYPHASE_DOT DotAvx512
+
+const PolyphaseFilterFunc* polyphase_filters_avx512(void)
+{
+    static const PolyphaseFilterFunc filters[] = { POLYPHASE_RATIOS(POLYPHASE_FILTER_ENTRY) };
+    return filters;
+}
+
+#else
+
+const PolyphaseFilterFunc* polyphase_filters_avx512(void)
+{
+    return NULL;
+}
+
+#endif
@@ -0,0 +1,66 @@
+// polyphase_filter.h : Rate pairs of the native resampler and the filter loop every kernel file instantiates.
+//
+
+#pragma once
+
+// Taps per phase for each unit of decimation ratio, rounded up to a multiple
+// of 16 floats so every kernel runs whole vectors without a tail.
+#define POLYPHASE_TAPS_PER_RATIO 48
+
+// The supported conversions as X(in_rate, out_rate); the order is the index
+// into every filter table.
+#define POLYPHASE_RATIOS(X) \
+    X(44100, 8000)          \
+    X(48000, 8000)          \
+    X(16000, 8000)
+
+// Filters count output samples of one channel. Output n is centred on input
+// position idx + (TAPS / 2 - 1) + (phase + n * M) / L of history and uses
+// the taps of its phase.
+typedef void (*PolyphaseFilterFunc)(const float* coeffs, const float* history, int idx, int phase, float* dst, int count);
+
+// Everything here is static or a template of constants: the kernel files are
+// built for different instruction sets, and a shared out-of-line copy could
+// end up running AVX code on a CPU without it.
+static constexpr int polyphase_gcd(int a, int b)
+{
+    return b ? polyphase_gcd(b, a % b) : a;
+}
+
+static constexpr int polyphase_taps(int l, int m)
+{
+    return (POLYPHASE_TAPS_PER_RATIO * (m > l ? m : l) / l + 15) / 16 * 16;
+}
+
+// Output phases L, input step M and filter length of one rate pair, as
+// compile-time constants for the loop below.
+template <int IN_RATE, int OUT_RATE>
+struct PolyphaseRatio {
+    static constexpr int L = OUT_RATE / polyphase_gcd(IN_RATE, OUT_RATE);
+    static constexpr int M = IN_RATE / polyphase_gcd(IN_RATE, OUT_RATE);
+    static constexpr int TAPS = polyphase_taps(L, M);
+
+    static_assert(TAPS % 16 == 0, "kernels need whole 16-float vectors");
+};
+
+template <int IN_RATE, int OUT_RATE, class Dot>
+static void polyphase_filter(const float* coeffs, const float* history, int idx, int phase, float* dst, int count)
+{
+    typedef PolyphaseRatio<IN_RATE, OUT_RATE> R;
+
+    for (int n = 0; n < count; n++) {
+        dst[n] = Dot::template dot<R::TAPS>(coeffs + phase * R::TAPS, history + idx);
+        phase += R::M;
+        idx += phase / R::L;
+        phase %= R::L;
+    }
+}
+
+#define POLYPHASE_FILTER_ENTRY(in_rate, out_rate) polyphase_filter<in_rate, out_rate, POLYPHASE_DOT>,
+
+// Filter tables indexed like POLYPHASE_RATIOS, NULL when the kernel file was
+// built for a different architecture.
+const PolyphaseFilterFunc* polyphase_filters_scalar(void);
+const PolyphaseFilterFunc* polyphase_filters_sse2(void);
+const PolyphaseFilterFunc* polyphase_filters_avx2(void);
+const PolyphaseFilterFunc* polyphase_filters_avx512(void);
@@ -0,0 +1,49 @@
+// polyphase_sse2.cpp : SSE2 filter kernels, the x86-64 baseline.
+//
+
+#include "polyphase_filter.h"
+
+#include <cstddef>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <emmintrin.h>
+
+struct DotSse2 {
+    template <int TAPS>
+    static inline float dot(const float* h, const float* x)
+    {
+        __m128 acc0 = _mm_setzero_ps();
+        __m128 acc1 = _mm_setzero_ps();
+        __m128 acc2 = _mm_setzero_ps();
+        __m128 acc3 = _mm_setzero_ps();
+
+        for (int k = 0; k < TAPS; k += 16) {
+            acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(h + k), _mm_loadu_ps(x + k)));
+            acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(h + k + 4), _mm_loadu_ps(x + k + 4)));
+            acc2 = _mm_add_ps(acc2, _mm_mul_ps(_mm_loadu_ps(h + k + 8), _mm_loadu_ps(x + k + 8)));
+            acc3 = _mm_add_ps(acc3, _mm_mul_ps(_mm_loadu_ps(h + k + 12), _mm_loadu_ps(x + k + 12)));
+        }
+
+        __m128 sum = _mm_add_ps(_mm_add_ps(acc0, acc1), _mm_add_ps(acc2, acc3));
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+        return _mm_cvtss_f32(sum);
+    }
+};
+
+#define POLYPHASE_DOT DotSse2
+
+const PolyphaseFilterFunc* polyphase_filters_sse2(void)
+{
+    static const PolyphaseFilterFunc filters[] = { POLYPHASE_RATIOS(POLYPHASE_FILTER_ENTRY) };
+    return filters;
+}
+
+#else
+
+const PolyphaseFilterFunc* polyphase_filters_sse2(void)
+{
+    return NULL;
+}
+
+#endif
@@ -0,0 +1,209 @@
+// resampler.cpp : Picks the engine per conversion and forwards to it.
+//
+
+#include "resampler.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+
+extern "C" {
+#include <libavutil/channel_layout.h>
+#include <libavutil/error.h>
+#include <libavutil/mem.h>
+}
+
+static std::atomic<int> current_engine(RESAMPLER_SWR);
+
+static enum SampleDither mix_dither = SAMPLE_DITHER_NONE;
+static SampleMixMatrix mix_matrix;
+static int has_mix_matrix;
+
+void resampler_set_engine(enum ResamplerEngine engine)
+{
+    current_engine = engine;
+}
+
+int resampler_parse_engine(const char* name, enum ResamplerEngine* engine)
+{
+    if (!strcmp(name, "swr"))
+        *engine = RESAMPLER_SWR;
+    else if (!strcmp(name, "native"))
+        *engine = RESAMPLER_NATIVE;
+    else {
+        fprintf(stderr, "Unknown resampler '%s'\n", name);
+        return AVERROR(EINVAL);
+    }
+
+    return 0;
+}
+
+int resampler_set_mix(enum SampleDither dither, const SampleMixMatrix* matrix, const OutputFormat* out)
+{
+    if (matrix && matrix->outChannels != output_format_channels(out)) {
+        fprintf(stderr, "Mix gains have %d rows, the output has %d channels\n",
+                matrix->outChannels, output_format_channels(out));
+        return AVERROR(EINVAL);
+    }
+    if ((matrix || dither != SAMPLE_DITHER_NONE) && current_engine != RESAMPLER_NATIVE)
+        fprintf(stderr, "WARNING: mix gains and dither only apply to the native resampler, ignored\n");
+    else if ((matrix || dither != SAMPLE_DITHER_NONE) && out->sampleFmt != AV_SAMPLE_FMT_S16)
+        fprintf(stderr, "WARNING: mix gains and dither only apply to s16 and G.711 output, ignored\n");
+
+    mix_dither = dither;
+    has_mix_matrix = matrix != NULL;
+    if (matrix)
+        mix_matrix = *matrix;
+    return 0;
+}
+
+void resampler_init(Resampler* resampler)
+{
+    resampler->swr = NULL;
+    resampler->native = NULL;
+    resampler->mix = NULL;
+    resampler->staging = NULL;
+    resampler->stagingSize = 0;
+    resampler->stagingChannels = 0;
+    resampler->law = G711_NONE;
+    resampler->outChannels = 0;
+}
+
+// The native engine keeps the layout, mixes stereo down to mono, or applies
+// the configured gains; any other remix is swr's. Returns 0 when it does not
+// take the conversion.
+static int open_native(Resampler* r, const SwrPoolKey* key)
+{
+    int in_channels = av_get_channel_layout_nb_channels(key->inChannelLayout);
+    int out_channels = av_get_channel_layout_nb_channels(key->outChannelLayout);
+    const SampleMixMatrix* matrix = has_mix_matrix && mix_matrix.inChannels == in_channels &&
+                                    mix_matrix.outChannels == out_channels ? &mix_matrix : NULL;
+    // The equal-weight mono mix is what swr's default matrix reduces to for
+    // stereo into integer output. Surround layouts get centre and LFE
+    // weights, and float output is not normalised, so those stay with swr.
+    int plain_mono = key->inChannelLayout == AV_CH_LAYOUT_STEREO && key->outChannelLayout == AV_CH_LAYOUT_MONO &&
+                     av_get_packed_sample_fmt(key->outSampleFmt) < AV_SAMPLE_FMT_FLT;
+
+    if (!matrix && key->outChannelLayout != key->inChannelLayout && !plain_mono)
+        return 0;
+
+    // Only the mixer applies gains and dither, and it only writes s16.
+    if (key->outSampleFmt != AV_SAMPLE_FMT_S16) {
+        if (matrix)
+            return 0;
+        r->native = polyphase_alloc(key->inSampleRate, in_channels, key->inSampleFmt,
+                                    key->outSampleRate, out_channels, key->outSampleFmt);
+        return r->native != NULL;
+    }
+
+    if (key->inSampleRate == key->outSampleRate) {
+        r->mix = sample_mix_alloc(in_channels, key->inSampleFmt, out_channels, matrix, mix_dither, r->law);
+        return r->mix != NULL;
+    }
+
+    // The mixer goes after the filter, where there are fewer samples to
+    // quantise. The filter does a plain mono downmix itself, so it runs once;
+    // explicit gains need every input channel filtered.
+    int filtered = matrix ? in_channels : out_channels;
+    r->native = polyphase_alloc(key->inSampleRate, in_channels, key->inSampleFmt,
+                                key->outSampleRate, filtered, AV_SAMPLE_FMT_FLT);
+    r->mix = sample_mix_alloc(filtered, AV_SAMPLE_FMT_FLT, out_channels, matrix, mix_dither, r->law);
+    r->stagingChannels = filtered;
+    if (!r->native || !r->mix) {
+        resampler_close(r);
+        return 0;
+    }
+
+    return 1;
+}
+
+int resampler_open(Resampler* resampler, const SwrPoolKey* key, enum G711Law law)
+{
+    resampler_init(resampler);
+    resampler->law = law;
+    resampler->outChannels = av_get_channel_layout_nb_channels(key->outChannelLayout);
+
+    if (current_engine == RESAMPLER_NATIVE && has_mix_matrix &&
+        mix_matrix.inChannels != av_get_channel_layout_nb_channels(key->inChannelLayout)) {
+        fprintf(stderr, "Mix gains have %d columns, the input has %d channels\n",
+                mix_matrix.inChannels, av_get_channel_layout_nb_channels(key->inChannelLayout));
+        return AVERROR(EINVAL);
+    }
+    if (current_engine == RESAMPLER_NATIVE && open_native(resampler, key))
+        return 0;
+
+    resampler->swr = swr_pool_acquire(key);
+    return resampler->swr ? 0 : AVERROR(ENOMEM);
+}
+
+int resampler_is_open(const Resampler* resampler)
+{
+    return resampler->swr || resampler->native || resampler->mix;
+}
+
+int resampler_get_out_samples(Resampler* resampler, int in_count)
+{
+    if (resampler->native)
+        return polyphase_get_out_samples(resampler->native, in_count);
+    if (resampler->mix)
+        return in_count;
+    return swr_get_out_samples(resampler->swr, in_count);
+}
+
+// Filters into float staging and has the mixer write the s16 output.
+static int convert_filtered(Resampler* r, uint8_t** out, int out_count, const uint8_t** in, int in_count)
+{
+    if (out_count > r->stagingSize) {
+        av_freep(&r->staging);
+        r->stagingSize = 0;
+        r->staging = (float*)av_malloc(sizeof(float) * out_count * r->stagingChannels);
+        if (!r->staging)
+            return AVERROR(ENOMEM);
+        r->stagingSize = out_count;
+    }
+
+    uint8_t* staging = (uint8_t*)r->staging;
+    int ret = polyphase_convert(r->native, &staging, out_count, in, in_count);
+    if (ret > 0)
+        sample_mix_convert(r->mix, out[0], (const uint8_t**)&staging, ret);
+
+    return ret;
+}
+
+// s16 from swr or the filter, companded in place when the output is G.711.
+static int finish(Resampler* r, uint8_t** out, int ret)
+{
+    if (ret > 0 && r->law != G711_NONE)
+        g711_encode(r->law, (const int16_t*)out[0], out[0], ret * r->outChannels);
+    return ret;
+}
+
+int resampler_convert(Resampler* resampler, uint8_t** out, int out_count, const uint8_t** in, int in_count)
+{
+    if (resampler->native && resampler->mix)
+        return convert_filtered(resampler, out, out_count, in, in_count);
+    if (resampler->native)
+        return finish(resampler, out, polyphase_convert(resampler->native, out, out_count, in, in_count));
+
+    // The mixer holds nothing back: there is nothing to drain, and the output
+    // has to take the whole input.
+    if (resampler->mix) {
+        if (!in)
+            return 0;
+        if (out_count < in_count)
+            return AVERROR(EINVAL);
+        sample_mix_convert(resampler->mix, out[0], in, in_count);
+        return in_count;
+    }
+
+    return finish(resampler, out, swr_convert(resampler->swr, out, out_count, in, in_count));
+}
+
+void resampler_close(Resampler* resampler)
+{
+    polyphase_free(&resampler->native);
+    sample_mix_free(&resampler->mix);
+    av_freep(&resampler->staging);
+    resampler->stagingSize = 0;
+    swr_pool_release(&resampler->swr);
+}
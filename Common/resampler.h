@@ -0,0 +1,66 @@
+// resampler.h : Sample rate and format conversion through swresample or the native polyphase engine.
+//
+
+#pragma once
+
+#include "output_format.h"
+#include "polyphase.h"
+#include "sample_mix.h"
+#include "swr_pool.h"
+
+enum ResamplerEngine {
+    RESAMPLER_SWR,
+    // The polyphase filter where polyphase_supported() allows, and the sample
+    // mixer for s16 output, after the filter or alone when the rate stays;
+    // swr otherwise.
+    RESAMPLER_NATIVE,
+};
+
+// Either swr is set, or the native engine: the polyphase filter, the mixer,
+// or the filter writing float into staging for the mixer to finish.
+typedef struct RESAMPLER {
+    SwrContext* swr;
+    PolyphaseResampler* native;
+    SampleMixer* mix;
+
+    float* staging;
+    int stagingSize;
+    int stagingChannels;
+
+    // G.711 output: the mixer compands as it stores, the other engines' s16
+    // is companded in place after them.
+    enum G711Law law;
+    int outChannels;
+} Resampler;
+
+// Engine of every resampler opened afterwards; swr until changed. Set once at
+// startup, before any conversion runs.
+void resampler_set_engine(enum ResamplerEngine engine);
+
+// Parses swr or native. Returns 0 or a negative AVERROR.
+int resampler_parse_engine(const char* name, enum ResamplerEngine* engine);
+
+// Dither and downmix gains of native s16 output; none and the stereo to mono
+// mix until changed. matrix may be NULL and is copied. Set once at startup,
+// after the engine. Warns when out or the engine leaves them unused, and
+// returns AVERROR(EINVAL) when matrix does not have a row per channel of out.
+// resampler_open() then fails for input whose channels do not match its
+// columns. Returns 0 or a negative AVERROR.
+int resampler_set_mix(enum SampleDither dither, const SampleMixMatrix* matrix, const OutputFormat* out);
+
+void resampler_init(Resampler* resampler);
+
+// Opens a resampler converting key's input to its output, taking swr contexts
+// from the pool. With a G.711 law the output format must be s16 and the
+// converted samples come out as one companded byte each.
+// Returns 0 or a negative AVERROR.
+int resampler_open(Resampler* resampler, const SwrPoolKey* key, enum G711Law law);
+
+int resampler_is_open(const Resampler* resampler);
+
+// swr_get_out_samples() and swr_convert() of whichever engine is open.
+int resampler_get_out_samples(Resampler* resampler, int in_count);
+int resampler_convert(Resampler* resampler, uint8_t** out, int out_count, const uint8_t** in, int in_count);
+
+// Frees the native engine or returns the swr context to the pool.
+void resampler_close(Resampler* resampler);
@@ -0,0 +1,378 @@
+// sample_mix.cpp : Block loop of the sample mixer, input loading, the noise shaping loop and kernel dispatch.
+//
+
+#include "sample_mix.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+
+#include "polyphase.h"
+#include "sample_mix_kernels.h"
+
+extern "C" {
+#include <libavutil/error.h>
+#include <libavutil/mem.h>
+}
+
+struct SAMPLE_MIXER {
+    const SampleMixKernels* kernels;
+
+    int inChannels;
+    enum AVSampleFormat inFmt;
+    int outChannels;
+    float gains[SAMPLE_MIX_MAX_CHANNELS * SAMPLE_MIX_MAX_CHANNELS];
+
+    // Input channel an output channel copies at unity gain, or -1 when it is
+    // a real mix.
+    int source[SAMPLE_MIX_MAX_CHANNELS];
+
+    enum SampleDither dither;
+    enum G711Law law;
+    uint32_t state[SAMPLE_MIX_NOISE_LANES];
+    // Rounding error of the last sample per output channel, for the shaping.
+    float error[SAMPLE_MIX_MAX_CHANNELS];
+
+    // One block of input as float per channel, unless it already is.
+    float planes[SAMPLE_MIX_MAX_CHANNELS][SAMPLE_MIX_BLOCK];
+    float mixed[SAMPLE_MIX_BLOCK];
+    float noise[SAMPLE_MIX_BLOCK];
+    int16_t quantized[SAMPLE_MIX_BLOCK];
+};
+
+static void mix_scalar(const float* const* planes, const float* gains, int channels, float* dst, int count)
+{
+    for (int i = 0; i < count; i++) {
+        float sum = gains[0] * planes[0][i];
+        for (int c = 1; c < channels; c++)
+            sum += gains[c] * planes[c][i];
+        dst[i] = sum;
+    }
+}
+
+static void tpdf_scalar(uint32_t* state, float* dst, int count)
+{
+    for (int i = 0; i < count; i += SAMPLE_MIX_NOISE_LANES) {
+        for (int lane = 0; lane < SAMPLE_MIX_NOISE_LANES; lane++) {
+            uint32_t s = state[lane];
+            s ^= s << 13;
+            s ^= s >> 17;
+            s ^= s << 5;
+            state[lane] = s;
+
+            // The two halves are two uniform draws; their difference is
+            // triangular.
+            dst[i + lane] = ((int)(s >> 16) - (int)(s & 0xffff)) * (1.0f / 65536);
+        }
+    }
+}
+
+static void quantize_scalar(const float* src, const float* noise, int16_t* dst, int count)
+{
+    for (int i = 0; i < count; i++) {
+        float v = src[i] * 32768;
+        if (noise)
+            v += noise[i];
+        dst[i] = (int16_t)lrintf(std::min(std::max(v, -32768.0f), 32767.0f));
+    }
+}
+
+const SampleMixKernels* sample_mix_kernels_scalar(void)
+{
+    static const SampleMixKernels kernels = { mix_scalar, tpdf_scalar, quantize_scalar };
+    return &kernels;
+}
+
+// The same CPU check and --isa cap as the polyphase filters; the mixer has no
+// AVX-512 set of its own, a block of it is memory bound well before that.
+static const SampleMixKernels* select_kernels(enum PolyphaseIsa isa)
+{
+    const SampleMixKernels* kernels = NULL;
+
+    switch (isa) {
+    case POLYPHASE_ISA_AVX512:
+    case POLYPHASE_ISA_AVX2:
+        kernels = sample_mix_kernels_avx2();
+        if (kernels)
+            break;
+        // fall through
+    case POLYPHASE_ISA_SSE2:
+        kernels = sample_mix_kernels_sse2();
+        if (kernels)
+            break;
+        // fall through
+    default:
+        kernels = sample_mix_kernels_scalar();
+    }
+
+    return kernels;
+}
+
+static int is_supported_fmt(enum AVSampleFormat fmt)
+{
+    return fmt == AV_SAMPLE_FMT_U8 || fmt == AV_SAMPLE_FMT_S16 ||
+           fmt == AV_SAMPLE_FMT_S32 || fmt == AV_SAMPLE_FMT_FLT;
+}
+
+static int matrix_fits(const SampleMixMatrix* matrix, int in_channels, int out_channels)
+{
+    return matrix && matrix->inChannels == in_channels && matrix->outChannels == out_channels;
+}
+
+int sample_mix_supported(int in_channels, enum AVSampleFormat in_fmt, int out_channels, enum AVSampleFormat out_fmt,
+                         const SampleMixMatrix* matrix)
+{
+    return in_channels >= 1 && in_channels <= SAMPLE_MIX_MAX_CHANNELS &&
+           out_channels >= 1 && out_channels <= SAMPLE_MIX_MAX_CHANNELS &&
+           (matrix_fits(matrix, in_channels, out_channels) || out_channels == in_channels ||
+            (out_channels == 1 && in_channels == 2)) &&
+           is_supported_fmt(av_get_packed_sample_fmt(in_fmt)) &&
+           out_fmt == AV_SAMPLE_FMT_S16;
+}
+
+SampleMixer* sample_mix_alloc(int in_channels, enum AVSampleFormat in_fmt, int out_channels,
+                              const SampleMixMatrix* matrix, enum SampleDither dither, enum G711Law law)
+{
+    if (!sample_mix_supported(in_channels, in_fmt, out_channels, AV_SAMPLE_FMT_S16, matrix))
+        return NULL;
+
+    SampleMixer* m = (SampleMixer*)av_mallocz(sizeof(SampleMixer));
+    if (!m)
+        return NULL;
+
+    m->kernels = select_kernels(polyphase_isa());
+    m->inChannels = in_channels;
+    m->inFmt = in_fmt;
+    m->outChannels = out_channels;
+    m->dither = dither;
+    m->law = law;
+
+    for (int o = 0; o < out_channels; o++) {
+        float* row = m->gains + o * in_channels;
+
+        if (matrix_fits(matrix, in_channels, out_channels))
+            memcpy(row, matrix->coeffs + o * in_channels, sizeof(float) * in_channels);
+        else if (out_channels == in_channels)
+            row[o] = 1;
+        else {
+            for (int c = 0; c < in_channels; c++)
+                row[c] = 1.0f / in_channels;
+        }
+
+        int zeros = (int)std::count(row, row + in_channels, 0.0f);
+        m->source[o] = -1;
+        for (int c = 0; c < in_channels; c++) {
+            if (row[c] == 1 && zeros == in_channels - 1)
+                m->source[o] = c;
+        }
+    }
+
+    // xorshift32 needs a non-zero state; any distinct seeds will do.
+    for (int lane = 0; lane < SAMPLE_MIX_NOISE_LANES; lane++)
+        m->state[lane] = 0x9e3779b9u * (lane + 1);
+
+    return m;
+}
+
+static inline float to_float(uint8_t v) { return (v - 128) * (1.0f / 128); }
+static inline float to_float(int16_t v) { return v * (1.0f / 32768); }
+static inline float to_float(int32_t v) { return (float)(v * (1.0 / 2147483648.0)); }
+static inline float to_float(float v) { return v; }
+
+// Points planes at count frames of input from frame offset on, converting to
+// float where the input is not planar float already.
+template <typename T>
+static void load_block(SampleMixer* m, const uint8_t** in, int offset, int count, const float** planes)
+{
+    int channels = m->inChannels;
+    int planar = av_sample_fmt_is_planar(m->inFmt) || channels == 1;
+    int stride = planar ? 1 : channels;
+
+    if (!planar && channels == 2) {
+        // The common interleaved stereo: split both channels in one pass.
+        const T* src = (const T*)in[0] + (size_t)offset * 2;
+        float* left = m->planes[0];
+        float* right = m->planes[1];
+
+        for (int i = 0; i < count; i++) {
+            left[i] = to_float(src[2 * i]);
+            right[i] = to_float(src[2 * i + 1]);
+        }
+        planes[0] = left;
+        planes[1] = right;
+        return;
+    }
+
+    for (int c = 0; c < channels; c++) {
+        const T* src = planar ? (const T*)in[c] + offset : (const T*)in[0] + (size_t)offset * channels + c;
+
+        if (std::is_same<T, float>::value && planar) {
+            planes[c] = (const float*)src;
+            continue;
+        }
+
+        float* dst = m->planes[c];
+        for (int i = 0; i < count; i++)
+            dst[i] = to_float(src[i * stride]);
+        planes[c] = dst;
+    }
+}
+
+// First-order error feedback: each sample subtracts the rounding error of the
+// one before, so the error spectrum gets a (1 - z^-1) high-pass slope.
+static void quantize_shaped(const float* src, const float* noise, float* error, int16_t* dst, int count)
+{
+    float e = *error;
+
+    for (int i = 0; i < count; i++) {
+        float v = src[i] * 32768 - e;
+        float q = std::min(std::max(v + noise[i], -32768.0f), 32767.0f);
+        // Adding and removing 1.5 * 2^23 rounds to nearest even without a
+        // round trip through an integer register, which is the critical path
+        // of the loop.
+        q = (q + 12582912.0f) - 12582912.0f;
+        // Rounding plus TPDF noise stays within 1.5 LSB. Anything more is the
+        // overshoot of a clipped sample, which fed back would keep pinning the
+        // following samples at full scale long after a hot passage.
+        e = std::min(std::max(q - v, -1.5f), 1.5f);
+        dst[i] = (int16_t)q;
+    }
+
+    *error = e;
+}
+
+static void quantize_channel(SampleMixer* m, int o, const float* src, int16_t* dst, int count)
+{
+    const SampleMixKernels* k = m->kernels;
+    int noise_count = (count + SAMPLE_MIX_NOISE_LANES - 1) / SAMPLE_MIX_NOISE_LANES * SAMPLE_MIX_NOISE_LANES;
+
+    switch (m->dither) {
+    case SAMPLE_DITHER_TPDF:
+        k->tpdf(m->state, m->noise, noise_count);
+        k->quantize(src, m->noise, dst, count);
+        break;
+    case SAMPLE_DITHER_SHAPED:
+        k->tpdf(m->state, m->noise, noise_count);
+        quantize_shaped(src, m->noise, &m->error[o], dst, count);
+        break;
+    default:
+        k->quantize(src, NULL, dst, count);
+    }
+}
+
+void sample_mix_convert(SampleMixer* m, uint8_t* out, const uint8_t** in, int count)
+{
+    int16_t* dst = (int16_t*)out;
+    int out_channels = m->outChannels;
+
+    for (int done = 0; done < count; done += SAMPLE_MIX_BLOCK) {
+        int n = std::min(count - done, SAMPLE_MIX_BLOCK);
+        const float* planes[SAMPLE_MIX_MAX_CHANNELS];
+
+        switch (av_get_packed_sample_fmt(m->inFmt)) {
+        case AV_SAMPLE_FMT_U8:  load_block<uint8_t>(m, in, done, n, planes); break;
+        case AV_SAMPLE_FMT_S16: load_block<int16_t>(m, in, done, n, planes); break;
+        case AV_SAMPLE_FMT_S32: load_block<int32_t>(m, in, done, n, planes); break;
+        default:                load_block<float>(m, in, done, n, planes); break;
+        }
+
+        for (int o = 0; o < out_channels; o++) {
+            const float* src = m->source[o] >= 0 ? planes[m->source[o]] : m->mixed;
+            if (m->source[o] < 0)
+                m->kernels->mix(planes, m->gains + o * m->inChannels, m->inChannels, m->mixed, n);
+
+            // Mono s16 goes straight to the output; anything else is staged
+            // one channel at a time, companded and interleaved from there.
+            if (out_channels == 1 && m->law == G711_NONE) {
+                quantize_channel(m, o, src, dst + done, n);
+                continue;
+            }
+
+            quantize_channel(m, o, src, m->quantized, n);
+
+            if (m->law != G711_NONE) {
+                uint8_t* frame = out + (size_t)done * out_channels + o;
+                if (out_channels == 1) {
+                    g711_encode(m->law, m->quantized, frame, n);
+                    continue;
+                }
+
+                const uint8_t* coded = (const uint8_t*)m->quantized;
+                g711_encode(m->law, m->quantized, (uint8_t*)m->quantized, n);
+                for (int i = 0; i < n; i++)
+                    frame[i * out_channels] = coded[i];
+                continue;
+            }
+
+            int16_t* frame = dst + (size_t)done * out_channels + o;
+            for (int i = 0; i < n; i++)
+                frame[i * out_channels] = m->quantized[i];
+        }
+    }
+}
+
+void sample_mix_free(SampleMixer** mixer)
+{
+    av_freep(mixer);
+}
+
+int sample_mix_parse_dither(const char* name, enum SampleDither* dither)
+{
+    if (!strcmp(name, "none"))
+        *dither = SAMPLE_DITHER_NONE;
+    else if (!strcmp(name, "tpdf"))
+        *dither = SAMPLE_DITHER_TPDF;
+    else if (!strcmp(name, "shaped"))
+        *dither = SAMPLE_DITHER_SHAPED;
+    else {
+        fprintf(stderr, "Unknown dither '%s'\n", name);
+        return AVERROR(EINVAL);
+    }
+
+    return 0;
+}
+
+int sample_mix_parse_matrix(const char* text, SampleMixMatrix* matrix)
+{
+    int rows = 0, columns = 0, column = 0;
+    const char* p = text;
+
+    for (;;) {
+        char* end;
+        float gain = strtof(p, &end);
+
+        if (end == p || rows >= SAMPLE_MIX_MAX_CHANNELS || column >= SAMPLE_MIX_MAX_CHANNELS)
+            break;
+        matrix->coeffs[rows * SAMPLE_MIX_MAX_CHANNELS + column++] = gain;
+
+        if (*end == ',') {
+            p = end + 1;
+            continue;
+        }
+        if (rows > 0 && column != columns)
+            break;
+        columns = column;
+        column = 0;
+        rows++;
+
+        if (*end == '/') {
+            p = end + 1;
+            continue;
+        }
+        if (*end != '\0')
+            break;
+
+        // Repack the rows to the stride of the actual input channel count.
+        for (int o = 0; o < rows; o++)
+            memmove(matrix->coeffs + o * columns, matrix->coeffs + o * SAMPLE_MIX_MAX_CHANNELS, sizeof(float) * columns);
+        matrix->outChannels = rows;
+        matrix->inChannels = columns;
+        return 0;
+    }
+
+    fprintf(stderr, "Invalid mix matrix '%s'\n", text);
+    return AVERROR(EINVAL);
+}
@@ -0,0 +1,56 @@
+// sample_mix.h : Downmix, float to s16 conversion and dither fused into one pass over the input.
+//
+
+#pragma once
+
+#include <cstdint>
+
+#include "g711.h"
+
+extern "C" {
+#include <libavutil/samplefmt.h>
+}
+
+#define SAMPLE_MIX_MAX_CHANNELS 8
+
+enum SampleDither {
+    SAMPLE_DITHER_NONE,
+    // Triangular noise of +-1 LSB, flat across the band.
+    SAMPLE_DITHER_TPDF,
+    // The same noise with first-order error feedback, which moves the
+    // quantisation noise away from the low frequencies.
+    SAMPLE_DITHER_SHAPED,
+};
+
+// Gain of input channel c in output channel o at coeffs[o * inChannels + c].
+typedef struct SAMPLE_MIX_MATRIX {
+    int outChannels;
+    int inChannels;
+    float coeffs[SAMPLE_MIX_MAX_CHANNELS * SAMPLE_MIX_MAX_CHANNELS];
+} SampleMixMatrix;
+
+typedef struct SAMPLE_MIXER SampleMixer;
+
+// True when sample_mix_alloc() takes the conversion: u8/s16/s32/flt input,
+// packed or planar, to packed s16. Without a matrix of matching size the
+// output keeps the channels or averages stereo to mono.
+int sample_mix_supported(int in_channels, enum AVSampleFormat in_fmt, int out_channels, enum AVSampleFormat out_fmt,
+                         const SampleMixMatrix* matrix);
+
+// matrix may be NULL, and is ignored when its size does not match. With a
+// G.711 law the s16 samples are companded to one byte each before they are
+// stored. Returns NULL when the conversion is not supported or memory runs out.
+SampleMixer* sample_mix_alloc(int in_channels, enum AVSampleFormat in_fmt, int out_channels,
+                              const SampleMixMatrix* matrix, enum SampleDither dither, enum G711Law law);
+
+// Converts count frames from in to packed s16, or G.711 bytes, at out.
+void sample_mix_convert(SampleMixer* mixer, uint8_t* out, const uint8_t** in, int count);
+
+void sample_mix_free(SampleMixer** mixer);
+
+// Parses none, tpdf or shaped. Returns 0 or a negative AVERROR.
+int sample_mix_parse_dither(const char* name, enum SampleDither* dither);
+
+// Parses comma separated gains, one row per output channel, rows separated by
+// '/': "0.7,0.3" mixes stereo to mono. Returns 0 or a negative AVERROR.
+int sample_mix_parse_matrix(const char* text, SampleMixMatrix* matrix);
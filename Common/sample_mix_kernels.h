@@ -0,0 +1,32 @@
+// sample_mix_kernels.h : Inner loops of the sample mixer, one set per instruction set.
+//
+
+#pragma once
+
+#include <cstdint>
+
+// Frames converted per pass. The float planes of one block stay in L1, so the
+// stages below run back to back over cached data.
+#define SAMPLE_MIX_BLOCK 512
+
+// Lanes of the dither generator; the noise buffer is filled in whole multiples
+// of this, so every kernel set draws the same sequence.
+#define SAMPLE_MIX_NOISE_LANES 16
+
+typedef struct SAMPLE_MIX_KERNELS {
+    // dst[i] = sum over c of gains[c] * planes[c][i], added in channel order.
+    void (*mix)(const float* const* planes, const float* gains, int channels, float* dst, int count);
+
+    // Triangular noise in (-1, 1), count a multiple of SAMPLE_MIX_NOISE_LANES.
+    // Sample i comes from the xorshift32 generator in state[i % 16].
+    void (*tpdf)(uint32_t* state, float* dst, int count);
+
+    // dst[i] = src[i] * 32768 + noise[i], clamped and rounded to nearest even.
+    // noise may be NULL.
+    void (*quantize)(const float* src, const float* noise, int16_t* dst, int count);
+} SampleMixKernels;
+
+// NULL when the kernel file was built for a different architecture.
+const SampleMixKernels* sample_mix_kernels_scalar(void);
+const SampleMixKernels* sample_mix_kernels_sse2(void);
+const SampleMixKernels* sample_mix_kernels_avx2(void);
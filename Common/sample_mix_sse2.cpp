@@ -0,0 +1,95 @@
+// sample_mix_sse2.cpp : SSE2 mixer kernels, the x86-64 baseline.
+//
+
+#include "sample_mix_kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <emmintrin.h>
+
+static void mix_sse2(const float* const* planes, const float* gains, int channels, float* dst, int count)
+{
+    int i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 sum = _mm_mul_ps(_mm_set1_ps(gains[0]), _mm_loadu_ps(planes[0] + i));
+        for (int c = 1; c < channels; c++)
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(gains[c]), _mm_loadu_ps(planes[c] + i)));
+        _mm_storeu_ps(dst + i, sum);
+    }
+
+    for (; i < count; i++) {
+        float sum = gains[0] * planes[0][i];
+        for (int c = 1; c < channels; c++)
+            sum += gains[c] * planes[c][i];
+        dst[i] = sum;
+    }
+}
+
+static void tpdf_sse2(uint32_t* state, float* dst, int count)
+{
+    const __m128i low = _mm_set1_epi32(0xffff);
+    const __m128 scale = _mm_set1_ps(1.0f / 65536);
+    __m128i s[4];
+
+    for (int k = 0; k < 4; k++)
+        s[k] = _mm_loadu_si128((const __m128i*)state + k);
+
+    for (int i = 0; i < count; i += SAMPLE_MIX_NOISE_LANES) {
+        for (int k = 0; k < 4; k++) {
+            s[k] = _mm_xor_si128(s[k], _mm_slli_epi32(s[k], 13));
+            s[k] = _mm_xor_si128(s[k], _mm_srli_epi32(s[k], 17));
+            s[k] = _mm_xor_si128(s[k], _mm_slli_epi32(s[k], 5));
+
+            __m128i d = _mm_sub_epi32(_mm_srli_epi32(s[k], 16), _mm_and_si128(s[k], low));
+            _mm_storeu_ps(dst + i + 4 * k, _mm_mul_ps(_mm_cvtepi32_ps(d), scale));
+        }
+    }
+
+    for (int k = 0; k < 4; k++)
+        _mm_storeu_si128((__m128i*)state + k, s[k]);
+}
+
+static inline __m128i quantize4(const float* src, const float* noise, int i)
+{
+    const __m128 lo = _mm_set1_ps(-32768.0f);
+    const __m128 hi = _mm_set1_ps(32767.0f);
+
+    __m128 v = _mm_mul_ps(_mm_loadu_ps(src + i), _mm_set1_ps(32768.0f));
+    if (noise)
+        v = _mm_add_ps(v, _mm_loadu_ps(noise + i));
+    return _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(v, lo), hi));
+}
+
+static void quantize_sse2(const float* src, const float* noise, int16_t* dst, int count)
+{
+    int i = 0;
+
+    for (; i + 8 <= count; i += 8)
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(quantize4(src, noise, i), quantize4(src, noise, i + 4)));
+
+    for (; i < count; i++) {
+        float v = src[i] * 32768;
+        if (noise)
+            v += noise[i];
+        dst[i] = (int16_t)lrintf(std::min(std::max(v, -32768.0f), 32767.0f));
+    }
+}
+
+const SampleMixKernels* sample_mix_kernels_sse2(void)
+{
+    static const SampleMixKernels kernels = { mix_sse2, tpdf_sse2, quantize_sse2 };
+    return &kernels;
+}
+
+#else
+
+const SampleMixKernels* sample_mix_kernels_sse2(void)
+{
+    return NULL;
+}
+
+#endif
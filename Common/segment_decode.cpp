@@ -0,0 +1,457 @@
+// segment_decode.cpp : One demuxer and decoder per segment, each output trimmed to its boundaries.
+//
+
+#include "segment_decode.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "batch.h"
+#include "compat.h"
+#include "decode_session.h"
+#include "wave_resample.h"
+
+extern "C" {
+#include <libavutil/mathematics.h>
+}
+
+// Each seam is checked on decoded input: SEGMENT_MATCH_FRAMES frames starting
+// SEGMENT_MATCH_LEAD before the boundary in the earlier segment are searched
+// for within SEGMENT_MATCH_SLACK either way in the later one (AV_TIME_BASE
+// units for both).
+#define SEGMENT_MATCH_FRAMES 2048
+#define SEGMENT_MATCH_LEAD 500000
+#define SEGMENT_MATCH_SLACK 250000
+
+#define SEGMENT_COPY_SIZE (1 << 20)
+
+// Decoded input frames [from, from + frames), first channel only for planar
+// formats.
+typedef struct SEGMENT_WINDOW {
+    int64_t from;
+    int64_t frames;
+    int64_t filled;
+    std::vector<uint8_t> data;
+} SegmentWindow;
+
+typedef struct SEGMENT {
+    int index;
+    int last;
+
+    // Input sample frames: the segment's share starts at inStart, a multiple
+    // of the resampler's phase period, and the resampler is fed from feedFrom.
+    // inRate is 0 for a single pass, which takes the stream as it comes.
+    int inRate;
+    int64_t inStart;
+    int64_t feedFrom;
+
+    // Input position of the next decoded frame, AV_NOPTS_VALUE until the first
+    // one. Segment 0 counts from 0; the others start from the first frame's
+    // timestamp plus shift, the correction found by matching the seams.
+    int64_t inPos;
+    int64_t shift;
+    int unit;
+
+    // probe covers this segment's start, tail the next one's.
+    SegmentWindow probe;
+    SegmentWindow tail;
+
+    // Output sample frames [start, end) of the whole result kept from here,
+    // the output position of feedFrom and of the next frame the session writes.
+    int64_t start;
+    int64_t end;
+    int64_t feedPos;
+    int64_t pos;
+
+    const OutputFormat* out;
+    int align;
+    DecodeSession* session;
+    AVStream* stream;
+
+    // sink for a single pass, spillSink over the temporary spill file otherwise.
+    OutputSink* dest;
+    FILE* spill;
+    OutputSink spillSink;
+
+    int64_t written;
+    int failed;
+} Segment;
+
+int segment_decode_count(AVFormatContext* format, int max_segments)
+{
+    if (!format->pb || !(format->pb->seekable & AVIO_SEEKABLE_NORMAL))
+        return 1;
+    if (format->iformat->flags & AVFMT_NOTIMESTAMPS)
+        return 1;
+    if (format->duration == AV_NOPTS_VALUE || format->duration <= 0)
+        return 1;
+
+    if (max_segments <= 0)
+        max_segments = batch_default_threads();
+
+    int64_t count = format->duration / ((int64_t)SEGMENT_MIN_SECONDS * AV_TIME_BASE);
+    return (int)std::max<int64_t>(1, std::min<int64_t>(count, max_segments));
+}
+
+static void window_record(SegmentWindow* window, const AVFrame* frame, int64_t pos, int unit)
+{
+    int64_t from = std::max(pos, window->from);
+    int64_t to = std::min(pos + frame->nb_samples, window->from + window->frames);
+
+    if (to <= from)
+        return;
+    if (window->data.empty())
+        window->data.resize((size_t)(window->frames * unit));
+
+    memcpy(window->data.data() + (from - window->from) * unit, frame->extended_data[0] + (from - pos) * unit,
+           (size_t)((to - from) * unit));
+    window->filled += to - from;
+}
+
+// Numbers the decoded frames, records the seam windows and drops the input
+// before feedFrom.
+static int segment_input(void* opaque, const AVFrame* frame)
+{
+    Segment* seg = (Segment*)opaque;
+    enum AVSampleFormat fmt = (enum AVSampleFormat)frame->format;
+    int unit = av_get_bytes_per_sample(fmt) * (av_sample_fmt_is_planar(fmt) ? 1 : frame->channels);
+
+    if (seg->inPos == AV_NOPTS_VALUE) {
+        if (seg->index == 0)
+            seg->inPos = 0;
+        else {
+            int64_t pts = frame->best_effort_timestamp;
+            if (pts == AV_NOPTS_VALUE) {
+                fprintf(stderr, "Segment %d: decoded audio has no timestamps\n", seg->index);
+                seg->failed = 1;
+                return AVERROR(EINVAL);
+            }
+
+            int64_t origin = seg->stream->start_time != AV_NOPTS_VALUE ? seg->stream->start_time : 0;
+            seg->inPos = av_rescale_q_rnd(pts - origin, seg->stream->time_base, AVRational{ 1, seg->inRate },
+                                          AV_ROUND_NEAR_INF) + seg->shift;
+            if (seg->inPos > std::min(seg->feedFrom, seg->probe.from)) {
+                fprintf(stderr, "Segment %d: seek landed after its pre-roll\n", seg->index);
+                seg->failed = 1;
+                return AVERROR(EINVAL);
+            }
+        }
+        seg->unit = unit;
+    }
+
+    if (seg->inRate && (frame->sample_rate != seg->inRate || unit != seg->unit)) {
+        fprintf(stderr, "Segment %d: the decoded format changes\n", seg->index);
+        seg->failed = 1;
+        return AVERROR(EINVAL);
+    }
+
+    int64_t pos = seg->inPos;
+    window_record(&seg->probe, frame, pos, unit);
+    window_record(&seg->tail, frame, pos, unit);
+    seg->inPos += frame->nb_samples;
+
+    return (int)std::min<int64_t>(std::max<int64_t>(seg->feedFrom - pos, 0), frame->nb_samples);
+}
+
+// Session output: everything before start is pre-roll, everything from end on
+// belongs to the next segment.
+static int segment_write(void* opaque, int64_t offset, const uint8_t* buf, int size)
+{
+    Segment* seg = (Segment*)opaque;
+    int64_t frames = size / seg->align;
+    int64_t from = std::max(seg->pos, seg->start);
+    int64_t to = std::min(seg->pos + frames, seg->end);
+
+    (void)offset;
+    if (to > from) {
+        int64_t bytes = (to - from) * seg->align;
+        if (output_sink_write(seg->dest, buf + (from - seg->pos) * seg->align, (size_t)bytes) != bytes) {
+            seg->failed = 1;
+            return -1;
+        }
+        seg->written += bytes;
+    }
+
+    seg->pos += frames;
+    return size;
+}
+
+static void decode_segment(Segment* seg, const char* filename, const InputOptions* input)
+{
+    AVFormatContext* format = NULL;
+    AVPacket* pkt = NULL;
+    OutputSink sink;
+    bool eof = false;
+
+    seg->failed = 1;
+    if (input_open_file(&format, filename, input) < 0)
+        return;
+
+    int stream_index = input_find_audio_stream(format, filename, input);
+    if (stream_index < 0)
+        goto end;
+    seg->stream = format->streams[stream_index];
+
+    // The segments already keep every core busy.
+    if (decode_session_open(&seg->session, seg->stream->codecpar, seg->out, 1) < 0)
+        goto end;
+    seg->session->input_func = segment_input;
+    seg->session->input_opaque = seg;
+
+    if (seg->index > 0) {
+        int64_t ts = av_rescale(seg->inStart, AV_TIME_BASE, seg->inRate) - SEGMENT_PREROLL;
+        if (format->start_time != AV_NOPTS_VALUE)
+            ts += format->start_time;
+        if (av_seek_frame(format, -1, ts, AVSEEK_FLAG_BACKWARD) < 0) {
+            fprintf(stderr, "Segment %d: could not seek in '%s'\n", seg->index, filename);
+            goto end;
+        }
+    }
+
+    pkt = av_packet_alloc();
+    if (!pkt)
+        goto end;
+
+    output_sink_init_callback(&sink, segment_write, seg);
+    seg->failed = 0;
+
+    // Decode errors right after the seek point are expected and, like in a
+    // single pass, not fatal; only the sink and the input numbering can abort.
+    while (!seg->failed && (seg->pos < seg->end || seg->tail.filled < seg->tail.frames)) {
+        if (av_read_frame(format, pkt) < 0) {
+            eof = true;
+            break;
+        }
+        if (pkt->stream_index == stream_index)
+            decode_session_send_packet(seg->session, pkt, &sink);
+        av_packet_unref(pkt);
+    }
+    if (!seg->failed && eof)
+        decode_session_flush(seg->session, &sink);
+
+    if (!seg->failed && seg->inPos == AV_NOPTS_VALUE) {
+        fprintf(stderr, "Segment %d: no audio decoded\n", seg->index);
+        seg->failed = 1;
+    }
+    if (!seg->failed && !seg->last && (seg->pos < seg->end || seg->tail.filled < seg->tail.frames)) {
+        fprintf(stderr, "Segment %d: input ended before its boundary\n", seg->index);
+        seg->failed = 1;
+    }
+
+end:
+    decode_session_free(&seg->session);
+    av_packet_free(&pkt);
+    avformat_close_input(&format);
+}
+
+static void decode_segments(std::vector<Segment*>& run, const char* filename, const InputOptions* input)
+{
+    std::vector<std::thread> pool;
+
+    for (size_t i = 1; i < run.size(); i++)
+        pool.emplace_back(decode_segment, run[i], filename, input);
+    decode_segment(run[0], filename, input);
+    for (std::thread& t : pool)
+        t.join();
+}
+
+// Rewinds a segment for another run with a new shift.
+static void segment_reset(Segment* seg)
+{
+    seg->inPos = AV_NOPTS_VALUE;
+    seg->probe.filled = 0;
+    seg->tail.filled = 0;
+    seg->pos = seg->feedPos;
+    seg->written = 0;
+    seg->failed = 0;
+
+    fseek64(seg->spill, 0, SEEK_SET);
+    output_sink_init_file(&seg->spillSink, seg->spill);
+}
+
+// How far the later segment's input numbering runs ahead of the earlier
+// one's, from where the earlier segment's tail shows up in its probe. Fails
+// unless there is exactly one such place.
+static int find_offset(const Segment* prev, const Segment* next, int64_t* offset)
+{
+    const SegmentWindow* tail = &prev->tail;
+    const SegmentWindow* probe = &next->probe;
+    int64_t slack = (probe->frames - tail->frames) / 2;
+    size_t unit = (size_t)prev->unit;
+    int matches = 0;
+
+    if (tail->filled != tail->frames || probe->filled != probe->frames || prev->unit != next->unit)
+        return -1;
+
+    for (int64_t o = -slack; o <= slack; o++) {
+        if (memcmp(probe->data.data() + (slack + o) * unit, tail->data.data(), (size_t)tail->frames * unit) == 0) {
+            *offset = o;
+            matches++;
+        }
+    }
+
+    if (matches != 1) {
+        fprintf(stderr, "Segment %d: %s decoded audio at its start\n", next->index,
+                matches ? "ambiguous" : "no matching");
+        return -1;
+    }
+    return 0;
+}
+
+// Decodes every segment into its spill file and checks that the seams line up
+// sample for sample, re-running the segments whose numbering was off once.
+// Returns 0 when all spills can be joined, -1 otherwise.
+static int decode_split(std::vector<Segment>& segs, const char* filename, const InputOptions* input)
+{
+    std::vector<Segment*> run;
+
+    for (Segment& seg : segs) {
+        if (tmpfile_s(&seg.spill) != 0) {
+            fprintf(stderr, "Could not create a temporary file for segment %d\n", seg.index);
+            return -1;
+        }
+        output_sink_init_file(&seg.spillSink, seg.spill);
+        seg.dest = &seg.spillSink;
+        run.push_back(&seg);
+    }
+    decode_segments(run, filename, input);
+
+    // err is how far the timestamps put segment i off the exact numbering of
+    // segment 0, carried along the seams.
+    int64_t err = 0;
+    run.clear();
+    if (segs[0].failed)
+        return -1;
+    for (size_t i = 1; i < segs.size(); i++) {
+        int64_t offset;
+        if (segs[i].failed || find_offset(&segs[i - 1], &segs[i], &offset) < 0)
+            return -1;
+        err -= offset;
+        if (err == 0)
+            continue;
+
+        segs[i].shift += err;
+        segment_reset(&segs[i]);
+        run.push_back(&segs[i]);
+    }
+    if (run.empty())
+        return 0;
+    decode_segments(run, filename, input);
+
+    for (size_t i = 1; i < segs.size(); i++) {
+        int64_t offset;
+        if (segs[i].failed || find_offset(&segs[i - 1], &segs[i], &offset) < 0)
+            return -1;
+        if (offset != 0) {
+            fprintf(stderr, "Segment %d: still %lld samples off after a second run\n", segs[i].index, (long long)offset);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int append_spill(Segment* seg, OutputSink* sink)
+{
+    std::vector<uint8_t> buf(SEGMENT_COPY_SIZE);
+
+    if (fseek64(seg->spill, 0, SEEK_SET) != 0)
+        return AVERROR(EIO);
+
+    for (int64_t left = seg->written; left > 0;) {
+        size_t chunk = (size_t)std::min<int64_t>(left, SEGMENT_COPY_SIZE);
+        if (fread(buf.data(), 1, chunk, seg->spill) != chunk) {
+            fprintf(stderr, "Segment %d: could not read back its temporary file\n", seg->index);
+            return AVERROR(EIO);
+        }
+        int ret = output_sink_write(sink, buf.data(), chunk);
+        if (ret < 0)
+            return ret;
+        left -= chunk;
+    }
+
+    return 0;
+}
+
+static void segment_init(Segment* seg, int index, int last, int in_rate, const OutputFormat* out)
+{
+    seg->index = index;
+    seg->last = last;
+    seg->inRate = in_rate;
+    seg->inPos = AV_NOPTS_VALUE;
+    seg->end = INT64_MAX;
+    seg->out = out;
+    seg->align = output_format_block_align(out);
+}
+
+int64_t segment_decode_run(const char* filename, const InputOptions* input, int in_rate, const OutputFormat* out,
+                           int64_t duration, int segments, OutputSink* sink)
+{
+    std::vector<Segment> segs;
+    int64_t ret = -1;
+
+    // A resampler started at input frame n runs in phase with the single pass
+    // only when n is a multiple of step; output frame k of it is then frame
+    // k + n / step * out_step of the whole.
+    if (in_rate > 0 && segments > 1) {
+        int64_t gcd = av_gcd(in_rate, out->sampleRate);
+        int64_t step = in_rate / gcd;
+        int64_t out_step = out->sampleRate / gcd;
+        int64_t overlap = RESAMPLE_OVERLAP_TAPS * std::max<int64_t>(1, (in_rate + out->sampleRate - 1) / out->sampleRate);
+        int64_t preroll = (overlap + step - 1) / step * step;
+        int64_t total = av_rescale(duration, in_rate, AV_TIME_BASE);
+        int64_t lead = av_rescale(SEGMENT_MATCH_LEAD, in_rate, AV_TIME_BASE);
+        int64_t slack = av_rescale(SEGMENT_MATCH_SLACK, in_rate, AV_TIME_BASE);
+
+        segs.resize(segments);
+        for (int i = 0; i < segments; i++) {
+            Segment* seg = &segs[i];
+
+            segment_init(seg, i, i == segments - 1, in_rate, out);
+            seg->inStart = av_rescale(total, i, segments) / step * step;
+            seg->feedFrom = std::max<int64_t>(0, seg->inStart - preroll);
+            seg->start = seg->inStart / step * out_step;
+            seg->feedPos = seg->feedFrom / step * out_step;
+            seg->pos = seg->feedPos;
+            if (i > 0) {
+                seg->probe.from = seg->inStart - lead - slack;
+                seg->probe.frames = SEGMENT_MATCH_FRAMES + 2 * slack;
+                segs[i - 1].tail.from = seg->inStart - lead;
+                segs[i - 1].tail.frames = SEGMENT_MATCH_FRAMES;
+                segs[i - 1].end = seg->start;
+            }
+        }
+
+        if (lead >= SEGMENT_MATCH_FRAMES && segs[1].probe.from >= 0)
+            ret = decode_split(segs, filename, input);
+    }
+
+    int64_t written = 0;
+    if (ret == 0) {
+        for (size_t i = 0; i < segs.size() && ret == 0; i++) {
+            ret = append_spill(&segs[i], sink);
+            written += segs[i].written;
+        }
+    }
+    else {
+        // Nothing has reached sink yet.
+        Segment whole = {};
+
+        if (segments > 1)
+            fprintf(stderr, "Segment boundaries could not be matched exactly, decoding in one pass\n");
+        segment_init(&whole, 0, 1, 0, out);
+        whole.dest = sink;
+        decode_segment(&whole, filename, input);
+        ret = whole.failed ? AVERROR_INVALIDDATA : 0;
+        written = whole.written;
+    }
+
+    for (Segment& seg : segs) {
+        if (seg.spill)
+            fclose(seg.spill);
+    }
+
+    return ret < 0 ? ret : written;
+}
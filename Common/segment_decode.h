@@ -0,0 +1,38 @@
+// segment_decode.h : Decodes one long input as several time segments in parallel.
+//
+
+#pragma once
+
+#include <cstdint>
+
+#include "input_open.h"
+#include "output_format.h"
+#include "output_sink.h"
+
+// Shortest segment worth its own demuxer, decoder and thread.
+#define SEGMENT_MIN_SECONDS 60
+
+// Each segment after the first seeks this far before its start, so the
+// decoder (bit reservoir, overlap) has settled by the time the seam checks
+// and the resampler's pre-roll begin.
+#define SEGMENT_PREROLL 2000000
+
+// How many segments the opened input can be cut into, at most max_segments
+// (0 for one per core): 1 when it cannot seek, its duration is unknown or it
+// is too short to be worth it.
+int segment_decode_count(AVFormatContext* format, int max_segments);
+
+// Decodes the first audio stream of filename as segments pieces of duration
+// (AV_TIME_BASE units, as probed) on as many threads, each with its own
+// demuxer and decoder, and appends the result to sink in order. in_rate is
+// the stream's sample rate. Boundaries fall on input samples where the
+// resampler is back at phase 0; segment 0 numbers the decoded samples from
+// the start, the others from their first timestamp, checked by finding
+// decoded audio from before each boundary again in the next segment and
+// corrected with a second run when it is off. The last segment runs to the
+// real end of the input. Every segment goes to a temporary file that is only
+// copied to sink once all seams match; otherwise the input is decoded again in
+// one pass, as happens with decoders that do not converge to the same samples
+// after a seek. Returns the number of bytes written or a negative AVERROR.
+int64_t segment_decode_run(const char* filename, const InputOptions* input, int in_rate, const OutputFormat* out,
+                           int64_t duration, int segments, OutputSink* sink);
@@ -0,0 +1,149 @@
+// swr_pool.cpp : Keeps released SwrContexts around so their filters are built once.
+//
+
+#include "swr_pool.h"
+
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+extern "C" {
+#include <libavutil/opt.h>
+}
+
+typedef struct SWR_POOL_ENTRY {
+    SwrPoolKey key;
+    SwrContext* swr_ctx;
+} SwrPoolEntry;
+
+// Function statics, so the pool is usable from other static initialisers and
+// from worker threads started before main().
+static std::mutex& pool_mutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+static std::vector<SwrPoolEntry>& pool_entries()
+{
+    static std::vector<SwrPoolEntry> entries;
+    return entries;
+}
+
+static int key_equal(const SwrPoolKey* a, const SwrPoolKey* b)
+{
+    return a->inChannelLayout == b->inChannelLayout &&
+           a->inSampleRate == b->inSampleRate &&
+           a->inSampleFmt == b->inSampleFmt &&
+           a->outChannelLayout == b->outChannelLayout &&
+           a->outSampleRate == b->outSampleRate &&
+           a->outSampleFmt == b->outSampleFmt;
+}
+
+static void read_key(SwrContext* swr_ctx, SwrPoolKey* key)
+{
+    int64_t value;
+
+    memset(key, 0, sizeof(*key));
+    av_opt_get_int(swr_ctx, "in_channel_layout", 0, &key->inChannelLayout);
+    av_opt_get_int(swr_ctx, "in_sample_rate", 0, &value);
+    key->inSampleRate = (int)value;
+    av_opt_get_sample_fmt(swr_ctx, "in_sample_fmt", 0, &key->inSampleFmt);
+
+    av_opt_get_int(swr_ctx, "out_channel_layout", 0, &key->outChannelLayout);
+    av_opt_get_int(swr_ctx, "out_sample_rate", 0, &value);
+    key->outSampleRate = (int)value;
+    av_opt_get_sample_fmt(swr_ctx, "out_sample_fmt", 0, &key->outSampleFmt);
+}
+
+static SwrContext* alloc_context(const SwrPoolKey* key)
+{
+    SwrContext* swr_ctx = swr_alloc();
+    if (!swr_ctx) {
+        fprintf(stderr, "Could not allocate resampler context\n");
+        return NULL;
+    }
+
+    av_opt_set_int(swr_ctx, "in_channel_layout", key->inChannelLayout, 0);
+    av_opt_set_int(swr_ctx, "in_sample_rate", key->inSampleRate, 0);
+    av_opt_set_sample_fmt(swr_ctx, "in_sample_fmt", key->inSampleFmt, 0);
+
+    av_opt_set_int(swr_ctx, "out_channel_layout", key->outChannelLayout, 0);
+    av_opt_set_int(swr_ctx, "out_sample_rate", key->outSampleRate, 0);
+    av_opt_set_sample_fmt(swr_ctx, "out_sample_fmt", key->outSampleFmt, 0);
+
+    if (swr_init(swr_ctx) < 0) {
+        fprintf(stderr, "Could not initialize resampler context\n");
+        swr_free(&swr_ctx);
+        return NULL;
+    }
+
+    return swr_ctx;
+}
+
+SwrContext* swr_pool_acquire(const SwrPoolKey* key)
+{
+    SwrContext* swr_ctx = NULL;
+
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex());
+        std::vector<SwrPoolEntry>& entries = pool_entries();
+        for (size_t i = 0; i < entries.size(); i++) {
+            if (key_equal(&entries[i].key, key)) {
+                swr_ctx = entries[i].swr_ctx;
+                entries.erase(entries.begin() + i);
+                break;
+            }
+        }
+    }
+
+    if (!swr_ctx)
+        return alloc_context(key);
+
+    // Released contexts are closed; swr_init() clears the remaining state and
+    // only rebuilds the filter bank when the rates changed, which they have not.
+    if (swr_init(swr_ctx) < 0) {
+        fprintf(stderr, "Could not initialize resampler context\n");
+        swr_free(&swr_ctx);
+        return NULL;
+    }
+
+    return swr_ctx;
+}
+
+void swr_pool_release(SwrContext** swr_ctx)
+{
+    if (!*swr_ctx)
+        return;
+
+    SwrPoolEntry entry;
+    read_key(*swr_ctx, &entry.key);
+    swr_close(*swr_ctx);
+    entry.swr_ctx = *swr_ctx;
+    *swr_ctx = NULL;
+
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex());
+        std::vector<SwrPoolEntry>& entries = pool_entries();
+        if (entries.size() < SWR_POOL_MAX_IDLE) {
+            entries.push_back(entry);
+            return;
+        }
+    }
+
+    swr_free(&entry.swr_ctx);
+}
+
+void swr_pool_clear(void)
+{
+    std::vector<SwrPoolEntry> entries;
+
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex());
+        entries.swap(pool_entries());
+    }
+
+    for (SwrPoolEntry& entry : entries)
+        swr_free(&entry.swr_ctx);
+}
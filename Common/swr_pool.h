@@ -0,0 +1,36 @@
+// swr_pool.h : Process-wide cache of initialised resampler contexts.
+//
+
+#pragma once
+
+#include <cstdint>
+
+extern "C" {
+#include <libavutil/samplefmt.h>
+#include <libswresample/swresample.h>
+}
+
+// Idle contexts kept per process; a release beyond this frees the context.
+#define SWR_POOL_MAX_IDLE 32
+
+typedef struct SWR_POOL_KEY {
+    int64_t inChannelLayout;
+    int inSampleRate;
+    enum AVSampleFormat inSampleFmt;
+
+    int64_t outChannelLayout;
+    int outSampleRate;
+    enum AVSampleFormat outSampleFmt;
+} SwrPoolKey;
+
+// Checks out a context converting key's input to its output. An idle context
+// with the same parameters is reset and reused, which keeps its filter bank;
+// otherwise a new one is built. Returns NULL on failure. Thread safe.
+SwrContext* swr_pool_acquire(const SwrPoolKey* key);
+
+// Hands a context from swr_pool_acquire() back to the pool and sets *swr_ctx to
+// NULL. Any samples still buffered in it are discarded. Thread safe.
+void swr_pool_release(SwrContext** swr_ctx);
+
+// Frees every idle context.
+void swr_pool_clear(void);
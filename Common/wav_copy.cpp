@@ -0,0 +1,195 @@
+// wav_copy.cpp : Fast path for inputs that need no conversion at all.
+//
+
+#include "wav_copy.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include "compat.h"
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <unistd.h>
+#endif
+
+extern "C" {
+#include <libavutil/error.h>
+#include <libavutil/mem.h>
+}
+
+#define WAV_COPY_BUFFER_SIZE (1024 * 1024)
+
+// Largest single request handed to the kernel, well below the 2 GiB limit of
+// both calls.
+#define WAV_COPY_KERNEL_CHUNK (1 << 30)
+
+#ifdef __linux__
+static int64_t copy_kernel(int in_fd, int64_t offset, uint64_t size, int out_fd)
+{
+    off_t in_off = (off_t)offset;
+    off_t out_off = lseek(out_fd, 0, SEEK_END);
+    uint64_t done = 0;
+
+    if (out_off < 0)
+        return AVERROR(errno);
+
+    // copy_file_range() can share extents on reflink file systems; it fails
+    // with EXDEV or EINVAL across file systems on older kernels, where
+    // sendfile() still avoids the round trip through user space.
+    while (done < size) {
+        size_t chunk = size - done < WAV_COPY_KERNEL_CHUNK ? (size_t)(size - done) : WAV_COPY_KERNEL_CHUNK;
+        ssize_t n = copy_file_range(in_fd, &in_off, out_fd, &out_off, chunk, 0);
+        if (n < 0 && done == 0 && (errno == EXDEV || errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP))
+            break;
+        if (n < 0)
+            return AVERROR(errno);
+        if (n == 0)
+            return done;
+        done += n;
+    }
+    if (done == size)
+        return done;
+
+    if (lseek(out_fd, out_off, SEEK_SET) < 0)
+        return AVERROR(errno);
+    while (done < size) {
+        size_t chunk = size - done < WAV_COPY_KERNEL_CHUNK ? (size_t)(size - done) : WAV_COPY_KERNEL_CHUNK;
+        ssize_t n = sendfile(out_fd, in_fd, &in_off, chunk);
+        if (n < 0 && done == 0 && (errno == EINVAL || errno == ENOSYS))
+            return AVERROR(ENOSYS);
+        if (n < 0)
+            return AVERROR(errno);
+        if (n == 0)
+            return done;
+        done += n;
+    }
+
+    return done;
+}
+#endif
+
+static int64_t copy_buffered(FILE* infile, int64_t offset, uint64_t size, FILE* outfile)
+{
+    uint8_t* buffer = (uint8_t*)av_malloc(WAV_COPY_BUFFER_SIZE);
+    uint64_t done = 0;
+
+    if (!buffer)
+        return AVERROR(ENOMEM);
+    if (fseek64(infile, offset, SEEK_SET) != 0) {
+        av_free(buffer);
+        return AVERROR(EIO);
+    }
+
+    while (done < size) {
+        size_t want = size - done < WAV_COPY_BUFFER_SIZE ? (size_t)(size - done) : WAV_COPY_BUFFER_SIZE;
+        size_t got = fread(buffer, 1, want, infile);
+        if (got && fwrite(buffer, 1, got, outfile) != got) {
+            av_free(buffer);
+            return AVERROR(EIO);
+        }
+        done += got;
+        if (got != want)
+            break;
+    }
+
+    av_free(buffer);
+    return done;
+}
+
+int64_t wav_copy_range(FILE* infile, int64_t offset, uint64_t size, FILE* outfile)
+{
+#ifdef __linux__
+    if (fflush(outfile) != 0)
+        return AVERROR(EIO);
+
+    int64_t ret = copy_kernel(fileno(infile), offset, size, fileno(outfile));
+    if (ret != AVERROR(ENOSYS)) {
+        // The descriptors moved underneath the streams; resync them.
+        fseek64(outfile, 0, SEEK_END);
+        fseek64(infile, offset + (ret > 0 ? ret : 0), SEEK_SET);
+        return ret;
+    }
+    fseek64(outfile, 0, SEEK_END);
+#endif
+
+    return copy_buffered(infile, offset, size, outfile);
+}
+
+int wav_format_matches(const WavFormat* format, const OutputFormat* out)
+{
+    return format->bytesPerSample != 3 &&
+           format->sampleFmt == out->sampleFmt && out->law == G711_NONE &&
+           (int)format->sampleRate == out->sampleRate &&
+           format->channelLayout == out->channelLayout;
+}
+
+static int is_riff_wave(FILE* infile)
+{
+    uint8_t buf[12];
+    int ret = fread(buf, 1, sizeof(buf), infile) == sizeof(buf) &&
+              !memcmp(buf, "RIFF", 4) && !memcmp(buf + 8, "WAVE", 4);
+
+    rewind(infile);
+    return ret;
+}
+
+int wav_copy_file(const char* input, const char* output, const OutputFormat* out, int64_t* written)
+{
+    WavFormat format;
+    FILE* infile;
+    FILE* outfile;
+
+    *written = 0;
+
+    if (fopen_s(&infile, input, "rb") != 0)
+        return 0;
+
+    // Only whole sample frames are copied, and the result has to fit the
+    // 32-bit sizes of a canonical header.
+    if (!is_riff_wave(infile) || wav_read_format(infile, &format) < 0 ||
+        !wav_format_matches(&format, out) ||
+        format.dataSize > UINT32_MAX - WAV_HEADER_SIZE) {
+        fclose(infile);
+        return 0;
+    }
+
+    uint64_t size = format.dataSize - format.dataSize % format.blockAlign;
+
+    if (fopen_s(&outfile, output, "wb") != 0) {
+        fprintf(stderr, "Could not open destination file %s\n", output);
+        fclose(infile);
+        return AVERROR(EIO);
+    }
+
+    unsigned char headbuf[WAV_HEADER_SIZE];
+    output_format_wav_header(out, headbuf, (uint32_t)size);
+
+    int64_t ret = AVERROR(EIO);
+    if (fwrite(headbuf, 1, WAV_HEADER_SIZE, outfile) == WAV_HEADER_SIZE)
+        ret = wav_copy_range(infile, format.dataOffset, size, outfile);
+
+    // A truncated input leaves fewer bytes than the header promised.
+    if (ret >= 0 && (uint64_t)ret != size) {
+        ret -= ret % format.blockAlign;
+        output_format_wav_header(out, headbuf, (uint32_t)ret);
+        if (fseek64(outfile, 0, SEEK_SET) != 0 || fwrite(headbuf, 1, WAV_HEADER_SIZE, outfile) != WAV_HEADER_SIZE)
+            ret = AVERROR(EIO);
+    }
+
+    // The data chunk ends on an even offset, as the RIFF size assumes.
+    if (ret >= 0 && (ret & 1) && (fseek64(outfile, 0, SEEK_END) != 0 || fputc(0, outfile) == EOF))
+        ret = AVERROR(EIO);
+
+    if (fclose(outfile) != 0 && ret >= 0)
+        ret = AVERROR(EIO);
+    fclose(infile);
+
+    if (ret < 0) {
+        fprintf(stderr, "Could not copy %s to %s\n", input, output);
+        return (int)ret;
+    }
+
+    *written = ret;
+    return 1;
+}
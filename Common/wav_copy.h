@@ -0,0 +1,27 @@
+// wav_copy.h : Copies a WAV that is already in the output format without decoding it.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+
+#include "output_format.h"
+#include "wav_parser.h"
+
+// True when the data chunk described by format is already in the out format, so
+// its bytes can be copied without touching swr.
+int wav_format_matches(const WavFormat* format, const OutputFormat* out);
+
+// Copies size bytes starting at offset in infile to the end of outfile, in the
+// kernel where the platform allows it (copy_file_range(), then sendfile()) and
+// through a large buffer otherwise. Returns the number of bytes copied, which
+// is short only when infile ends early, or a negative AVERROR.
+int64_t wav_copy_range(FILE* infile, int64_t offset, uint64_t size, FILE* outfile);
+
+// If input is a RIFF/WAVE file whose samples are already in the out format,
+// writes output as a canonical 44-byte header followed by a verbatim copy of
+// the data chunk and sets *written to the data bytes copied.
+// Returns 1 when copied, 0 when input needs converting (nothing is written) or
+// a negative AVERROR.
+int wav_copy_file(const char* input, const char* output, const OutputFormat* out, int64_t* written);
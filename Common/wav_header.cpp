@@ -0,0 +1,264 @@
+// wav_header.cpp : Builds the header variants; the data offset is fixed at init.
+//
+
+#include "wav_header.h"
+
+#include <cstdio>
+#include <cstring>
+
+extern "C" {
+#include <libavutil/error.h>
+}
+
+// RIFF + fmt + data chunk headers.
+#define RIFF_HEADER_SIZE 44
+
+// ds64 body: RIFF size, data size, sample count (64 bits each), table length.
+#define DS64_BODY_SIZE 28
+
+// RIFF/RF64 with the ds64 (or placeholder JUNK) chunk after the RIFF header.
+#define RF64_HEADER_SIZE (RIFF_HEADER_SIZE + 8 + DS64_BODY_SIZE)
+
+// AUTO keeps the 44-byte header below this expected data size; the margin
+// covers durations that are only estimated from the bitrate.
+#define AUTO_RIFF_LIMIT 0xF0000000ULL
+
+#define W64_HEADER_SIZE 104
+
+// Non-PCM formats (G.711) extend fmt to a WAVEFORMATEX with cbSize 0, and in
+// RIFF and RF64 add a fact chunk with the frame count.
+#define FMT_EXTENSION_SIZE 2
+#define FACT_CHUNK_SIZE 12
+
+static const uint8_t W64_GUID_RIFF[16] = { 'r', 'i', 'f', 'f', 0x2E, 0x91, 0xCF, 0x11, 0xA5, 0xD6, 0x28, 0xDB, 0x04, 0xC1, 0x00, 0x00 };
+static const uint8_t W64_GUID_WAVE[16] = { 'w', 'a', 'v', 'e', 0xF3, 0xAC, 0xD3, 0x11, 0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A };
+static const uint8_t W64_GUID_FMT[16] = { 'f', 'm', 't', ' ', 0xF3, 0xAC, 0xD3, 0x11, 0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A };
+static const uint8_t W64_GUID_DATA[16] = { 'd', 'a', 't', 'a', 0xF3, 0xAC, 0xD3, 0x11, 0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A };
+
+static unsigned char* put_u16(unsigned char* p, uint32_t x)
+{
+    p[0] = (unsigned char)(x & 0xff);
+    p[1] = (unsigned char)((x >> 8) & 0xff);
+    return p + 2;
+}
+
+static unsigned char* put_u32(unsigned char* p, uint32_t x)
+{
+    put_u16(p, x & 0xffff);
+    put_u16(p + 2, x >> 16);
+    return p + 4;
+}
+
+static unsigned char* put_u64(unsigned char* p, uint64_t x)
+{
+    put_u32(p, (uint32_t)x);
+    put_u32(p + 4, (uint32_t)(x >> 32));
+    return p + 8;
+}
+
+static unsigned char* put_tag(unsigned char* p, const char* tag)
+{
+    memcpy(p, tag, 4);
+    return p + 4;
+}
+
+static unsigned char* put_guid(unsigned char* p, const uint8_t* guid)
+{
+    memcpy(p, guid, 16);
+    return p + 16;
+}
+
+static int is_extended(const OutputFormat* format)
+{
+    return format->law != G711_NONE;
+}
+
+static int fmt_body_size(const OutputFormat* format)
+{
+    return 16 + (is_extended(format) ? FMT_EXTENSION_SIZE : 0);
+}
+
+// The PCMWAVEFORMAT body shared by every container, plus cbSize for G.711.
+static unsigned char* put_fmt_body(unsigned char* p, const OutputFormat* format)
+{
+    int align = output_format_block_align(format);
+
+    p = put_u16(p, output_format_wav_tag(format));
+    p = put_u16(p, output_format_channels(format));
+    p = put_u32(p, format->sampleRate);
+    p = put_u32(p, format->sampleRate * align);
+    p = put_u16(p, align);
+    p = put_u16(p, output_format_bits(format));
+    return is_extended(format) ? put_u16(p, 0) : p;
+}
+
+int wav_header_parse_container(const char* name, enum WavContainer* container)
+{
+    if (!strcmp(name, "auto"))
+        *container = WAV_CONTAINER_AUTO;
+    else if (!strcmp(name, "wav") || !strcmp(name, "riff"))
+        *container = WAV_CONTAINER_RIFF;
+    else if (!strcmp(name, "rf64"))
+        *container = WAV_CONTAINER_RF64;
+    else if (!strcmp(name, "w64"))
+        *container = WAV_CONTAINER_W64;
+    else {
+        fprintf(stderr, "Unknown container '%s'\n", name);
+        return AVERROR(EINVAL);
+    }
+
+    return 0;
+}
+
+void wav_header_init(WavHeader* header, const OutputFormat* format, enum WavContainer container, int64_t expected_data_size)
+{
+    memset(header, 0, sizeof(*header));
+    header->format = *format;
+    header->container = container;
+
+    if (container == WAV_CONTAINER_AUTO) {
+        header->container = WAV_CONTAINER_RIFF;
+        header->reserveDs64 = expected_data_size <= 0 || (uint64_t)expected_data_size >= AUTO_RIFF_LIMIT;
+    }
+
+    if (header->container == WAV_CONTAINER_W64)
+        header->size = W64_HEADER_SIZE + (is_extended(format) ? 8 : 0);
+    else if (header->container == WAV_CONTAINER_RF64 || header->reserveDs64)
+        header->size = RF64_HEADER_SIZE;
+    else
+        header->size = RIFF_HEADER_SIZE;
+
+    if (header->container != WAV_CONTAINER_W64 && is_extended(format))
+        header->size += FMT_EXTENSION_SIZE + FACT_CHUNK_SIZE;
+}
+
+// RIFF chunks end on an even offset, Wave64 chunks on a multiple of 8. The
+// padding is counted in the RIFF size but not in the data chunk size.
+static int data_padding(const WavHeader* header, uint64_t data_size)
+{
+    if (data_size == WAV_HEADER_UNKNOWN_SIZE)
+        return 0;
+    if (header->container == WAV_CONTAINER_W64)
+        return (int)((8 - data_size % 8) % 8);
+    return (int)(data_size & 1);
+}
+
+static void build_w64(WavHeader* header, uint64_t data_size)
+{
+    unsigned char* p = header->buf;
+
+    // Wave64 sizes count the 24-byte chunk header itself.
+    p = put_guid(p, W64_GUID_RIFF);
+    p = put_u64(p, data_size == WAV_HEADER_UNKNOWN_SIZE ? 0 : header->size + data_size + data_padding(header, data_size));
+    p = put_guid(p, W64_GUID_WAVE);
+    p = put_guid(p, W64_GUID_FMT);
+    p = put_u64(p, 24 + fmt_body_size(&header->format));
+    p = put_fmt_body(p, &header->format);
+    // Wave64 chunks start on 8-byte boundaries.
+    while ((p - header->buf) % 8)
+        *p++ = 0;
+    p = put_guid(p, W64_GUID_DATA);
+    put_u64(p, data_size == WAV_HEADER_UNKNOWN_SIZE ? 0 : 24 + data_size);
+}
+
+static void build_riff(WavHeader* header, uint64_t data_size)
+{
+    unsigned char* p = header->buf;
+    uint64_t riff_size = data_size == WAV_HEADER_UNKNOWN_SIZE ? UINT64_MAX :
+                         header->size - 8 + data_size + data_padding(header, data_size);
+    int rf64 = header->container == WAV_CONTAINER_RF64 ||
+               (header->reserveDs64 && data_size != WAV_HEADER_UNKNOWN_SIZE && riff_size > UINT32_MAX);
+
+    p = put_tag(p, rf64 ? "RF64" : "RIFF");
+    p = put_u32(p, rf64 || riff_size > UINT32_MAX ? UINT32_MAX : (uint32_t)riff_size);
+    p = put_tag(p, "WAVE");
+
+    if (rf64) {
+        uint64_t known = data_size == WAV_HEADER_UNKNOWN_SIZE ? 0 : data_size;
+        int align = output_format_block_align(&header->format);
+
+        p = put_tag(p, "ds64");
+        p = put_u32(p, DS64_BODY_SIZE);
+        p = put_u64(p, data_size == WAV_HEADER_UNKNOWN_SIZE ? 0 : riff_size);
+        p = put_u64(p, known);
+        p = put_u64(p, align ? known / align : 0);
+        p = put_u32(p, 0);
+    }
+    else if (header->reserveDs64) {
+        // Same size as ds64, so the upgrade rewrites the header and nothing else.
+        p = put_tag(p, "JUNK");
+        p = put_u32(p, DS64_BODY_SIZE);
+        memset(p, 0, DS64_BODY_SIZE);
+        p += DS64_BODY_SIZE;
+    }
+
+    p = put_tag(p, "fmt ");
+    p = put_u32(p, fmt_body_size(&header->format));
+    p = put_fmt_body(p, &header->format);
+
+    if (is_extended(&header->format)) {
+        uint64_t frames = data_size == WAV_HEADER_UNKNOWN_SIZE ? 0 : data_size / output_format_block_align(&header->format);
+
+        // RF64 keeps the real count in ds64.
+        p = put_tag(p, "fact");
+        p = put_u32(p, 4);
+        p = put_u32(p, rf64 || frames > UINT32_MAX ? UINT32_MAX : (uint32_t)frames);
+    }
+
+    p = put_tag(p, "data");
+    put_u32(p, rf64 || data_size > UINT32_MAX ? UINT32_MAX : (uint32_t)data_size);
+}
+
+static void build(WavHeader* header, uint64_t data_size)
+{
+    if (header->container == WAV_CONTAINER_W64)
+        build_w64(header, data_size);
+    else
+        build_riff(header, data_size);
+}
+
+int wav_header_write(WavHeader* header, OutputSink* sink, uint64_t data_size)
+{
+    build(header, data_size);
+
+    if (output_sink_write(sink, header->buf, header->size) != header->size) {
+        fprintf(stderr, "ERROR: Failed to write wav header: \n");
+        return AVERROR(EIO);
+    }
+
+    return 0;
+}
+
+int wav_header_pad(WavHeader* header, OutputSink* sink, uint64_t data_size)
+{
+    static const unsigned char zeros[8] = { 0 };
+    int pad = data_padding(header, data_size);
+
+    if (pad && output_sink_write(sink, zeros, pad) != pad) {
+        fprintf(stderr, "ERROR: Failed to pad wav data chunk: \n");
+        return AVERROR(EIO);
+    }
+
+    return 0;
+}
+
+int wav_header_finalize(WavHeader* header, OutputSink* sink, uint64_t data_size)
+{
+    int ret = wav_header_pad(header, sink, data_size);
+    if (ret < 0)
+        return ret;
+
+    if (header->container == WAV_CONTAINER_RIFF && !header->reserveDs64 &&
+        data_size > UINT32_MAX - RIFF_HEADER_SIZE)
+        fprintf(stderr, "WARNING: %llu bytes of audio do not fit a RIFF header, sizes are clamped; use rf64 or w64\n",
+                (unsigned long long)data_size);
+
+    build(header, data_size);
+
+    if (output_sink_write_at(sink, 0, header->buf, header->size) != header->size) {
+        fprintf(stderr, "ERROR: Failed to write wav header: \n");
+        return AVERROR(EIO);
+    }
+
+    return 0;
+}
@@ -0,0 +1,59 @@
+// wav_header.h : RIFF, RF64 and Sony Wave64 headers for the converted output.
+//
+
+#pragma once
+
+#include <cstdint>
+
+#include "output_format.h"
+#include "output_sink.h"
+
+enum WavContainer {
+    // Canonical 44-byte RIFF when the expected size is known to fit, otherwise
+    // RIFF with a JUNK chunk reserving room for ds64, upgraded to RF64 in
+    // place if the data ends up crossing 4 GB.
+    WAV_CONTAINER_AUTO,
+    WAV_CONTAINER_RIFF,
+    WAV_CONTAINER_RF64,
+    WAV_CONTAINER_W64,
+};
+
+// Largest header, Wave64: riff, wave, fmt and data GUID chunks, with the fmt
+// chunk padded to 8 bytes when it carries cbSize.
+#define WAV_HEADER_MAX_SIZE 112
+
+// Data size passed before the length is known.
+#define WAV_HEADER_UNKNOWN_SIZE UINT64_MAX
+
+typedef struct WAV_HEADER {
+    enum WavContainer container;    // never WAV_CONTAINER_AUTO after init
+    int reserveDs64;                // RIFF with a JUNK chunk where ds64 goes
+    OutputFormat format;
+
+    int size;
+    unsigned char buf[WAV_HEADER_MAX_SIZE];
+} WavHeader;
+
+// Maps "auto", "wav", "rf64" or "w64" to a container. Returns 0 or AVERROR(EINVAL).
+int wav_header_parse_container(const char* name, enum WavContainer* container);
+
+// Picks the layout for format. expected_data_size is what the demuxer duration
+// predicts, 0 when unknown; it only matters for WAV_CONTAINER_AUTO.
+void wav_header_init(WavHeader* header, const OutputFormat* format, enum WavContainer container, int64_t expected_data_size);
+
+// Appends the preliminary header. data_size may be WAV_HEADER_UNKNOWN_SIZE, in
+// which case the sizes follow the streaming convention (all ones) for readers
+// that never see the final header. Returns 0 or a negative AVERROR.
+int wav_header_write(WavHeader* header, OutputSink* sink, uint64_t data_size);
+
+// Appends the zero bytes that end the data chunk on a chunk boundary: one after
+// an odd data_size in RIFF and RF64, up to seven in Wave64. Output that is never
+// finalized, such as a pipe, calls this after the last sample.
+// Returns 0 or a negative AVERROR.
+int wav_header_pad(WavHeader* header, OutputSink* sink, uint64_t data_size);
+
+// Pads the data chunk with wav_header_pad(), then rewrites the header at offset
+// 0 for data_size bytes of samples, switching a reserved RIFF header to RF64
+// when the sizes no longer fit in 32 bits. The header size never changes, so
+// the data is not moved. Returns 0 or a negative AVERROR.
+int wav_header_finalize(WavHeader* header, OutputSink* sink, uint64_t data_size);
@@ -0,0 +1,152 @@
+// wav_parser.cpp : Walks RIFF chunks and maps the fmt chunk to swresample formats.
+//
+
+#include "wav_parser.h"
+
+#include <cstring>
+
+#include "compat.h"
+
+extern "C" {
+#include <libavutil/channel_layout.h>
+#include <libavutil/common.h>
+#include <libavutil/error.h>
+#include <libavutil/mathematics.h>
+}
+
+#define RD_U16(buf) ((uint16_t)((buf)[0] | ((buf)[1] << 8)))
+#define RD_U32(buf) ((uint32_t)((buf)[0] | ((buf)[1] << 8) | ((buf)[2] << 16) | ((uint32_t)(buf)[3] << 24)))
+
+static enum AVSampleFormat map_sample_fmt(uint16_t formatTag, uint16_t bitsPerSample)
+{
+    if (formatTag == WAVE_FORMAT_PCM) {
+        switch (bitsPerSample) {
+        case 8:  return AV_SAMPLE_FMT_U8;
+        case 16: return AV_SAMPLE_FMT_S16;
+        case 24: return AV_SAMPLE_FMT_S32;
+        case 32: return AV_SAMPLE_FMT_S32;
+        }
+    }
+    else if (formatTag == WAVE_FORMAT_IEEE_FLOAT) {
+        switch (bitsPerSample) {
+        case 32: return AV_SAMPLE_FMT_FLT;
+        case 64: return AV_SAMPLE_FMT_DBL;
+        }
+    }
+
+    return AV_SAMPLE_FMT_NONE;
+}
+
+static int parse_fmt(const uint8_t* buf, uint32_t size, WavFormat* format)
+{
+    if (size < 16)
+        return AVERROR_INVALIDDATA;
+
+    format->formatTag = RD_U16(buf);
+    format->numChannels = RD_U16(buf + 2);
+    format->sampleRate = RD_U32(buf + 4);
+    format->blockAlign = RD_U16(buf + 12);
+    format->bitsPerSample = RD_U16(buf + 14);
+    format->channelMask = 0;
+
+    if (format->formatTag == WAVE_FORMAT_EXTENSIBLE) {
+        if (size < 40)
+            return AVERROR_INVALIDDATA;
+        format->channelMask = RD_U32(buf + 20);
+        // The first two bytes of the sub-format GUID are the plain format tag.
+        format->formatTag = RD_U16(buf + 24);
+    }
+
+    if (format->numChannels == 0 || format->sampleRate == 0 || format->bitsPerSample == 0)
+        return AVERROR_INVALIDDATA;
+
+    format->sampleFmt = map_sample_fmt(format->formatTag, format->bitsPerSample);
+    if (format->sampleFmt == AV_SAMPLE_FMT_NONE) {
+        fprintf(stderr, "Unsupported wave format %d with %d bits per sample\n",
+                format->formatTag, format->bitsPerSample);
+        return AVERROR_PATCHWELCOME;
+    }
+
+    format->bytesPerSample = format->bitsPerSample / 8;
+    if (format->blockAlign != format->numChannels * format->bytesPerSample)
+        return AVERROR_INVALIDDATA;
+
+    if (format->channelMask && av_popcount(format->channelMask) == format->numChannels)
+        format->channelLayout = format->channelMask;
+    else
+        format->channelLayout = av_get_default_channel_layout(format->numChannels);
+
+    return 0;
+}
+
+int wav_read_format(FILE* infile, WavFormat* format)
+{
+    uint8_t buf[40];
+    int have_fmt = 0;
+
+    memset(format, 0, sizeof(*format));
+
+    if (fread(buf, 1, 12, infile) != 12 || memcmp(buf, "RIFF", 4) || memcmp(buf + 8, "WAVE", 4)) {
+        fprintf(stderr, "Not a RIFF/WAVE file\n");
+        return AVERROR_INVALIDDATA;
+    }
+
+    for (;;) {
+        if (fread(buf, 1, 8, infile) != 8) {
+            fprintf(stderr, "No data chunk found\n");
+            return AVERROR_INVALIDDATA;
+        }
+
+        uint32_t size = RD_U32(buf + 4);
+        int64_t next = ftell64(infile) + size + (size & 1);
+
+        if (!memcmp(buf, "fmt ", 4)) {
+            uint32_t len = size < sizeof(buf) ? size : sizeof(buf);
+            if (fread(buf, 1, len, infile) != len)
+                return AVERROR_INVALIDDATA;
+
+            int ret = parse_fmt(buf, len, format);
+            if (ret < 0)
+                return ret;
+            have_fmt = 1;
+        }
+        else if (!memcmp(buf, "data", 4)) {
+            if (!have_fmt) {
+                fprintf(stderr, "data chunk before fmt chunk\n");
+                return AVERROR_INVALIDDATA;
+            }
+
+            format->dataOffset = ftell64(infile);
+            format->dataSize = size;
+
+            // Streaming writers leave the size unset; use whatever the file holds.
+            // A truncated file never claims more than it has, so the mapped
+            // reader cannot touch pages past the end.
+            if (fseek64(infile, 0, SEEK_END) == 0) {
+                uint64_t available = (uint64_t)FFMAX(ftell64(infile) - format->dataOffset, 0);
+                if (size == 0 || size == 0xFFFFFFFF || format->dataSize > available)
+                    format->dataSize = available;
+                if (fseek64(infile, format->dataOffset, SEEK_SET) != 0)
+                    return AVERROR(EIO);
+            }
+            return 0;
+        }
+
+        if (fseek64(infile, next, SEEK_SET) != 0)
+            return AVERROR_INVALIDDATA;
+    }
+}
+
+int64_t wav_duration(const WavFormat* format)
+{
+    if (format->blockAlign == 0 || format->sampleRate == 0)
+        return 0;
+
+    return av_rescale((int64_t)(format->dataSize / format->blockAlign), AV_TIME_BASE, format->sampleRate);
+}
+
+void wav_unpack_s24(int32_t* dst, const uint8_t* src, int nb_samples)
+{
+    for (int i = 0; i < nb_samples; i++, src += 3)
+        dst[i] = (int32_t)((uint32_t)src[0] << 8 | (uint32_t)src[1] << 16 | (uint32_t)src[2] << 24);
+}
@@ -0,0 +1,47 @@
+// wav_parser.h : RIFF/WAVE chunk parser for PCM and IEEE float files.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+
+extern "C" {
+#include <libavutil/samplefmt.h>
+}
+
+#define WAVE_FORMAT_PCM 0x0001
+#define WAVE_FORMAT_IEEE_FLOAT 0x0003
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+
+typedef struct WAV_FORMAT {
+    // fmt chunk, with WAVE_FORMAT_EXTENSIBLE resolved to its sub-format.
+    uint16_t formatTag;
+    uint16_t numChannels;
+    uint32_t sampleRate;
+    uint16_t blockAlign;
+    uint16_t bitsPerSample;
+    uint32_t channelMask;
+
+    // Packed sample format the data is handed to swresample as. 24-bit PCM
+    // has no packed equivalent and is widened to AV_SAMPLE_FMT_S32 on read.
+    enum AVSampleFormat sampleFmt;
+    int64_t channelLayout;
+    int bytesPerSample;
+
+    // dataSize never reaches past the end of the file.
+    int64_t dataOffset;
+    uint64_t dataSize;
+} WavFormat;
+
+// Walks the chunks of a RIFF/WAVE file, skipping LIST, fact, bext, JUNK and any
+// other chunk until data. On success infile is positioned at the first sample.
+// Returns 0, AVERROR_INVALIDDATA for malformed files or AVERROR_PATCHWELCOME for
+// encodings other than integer PCM and IEEE float.
+int wav_read_format(FILE* infile, WavFormat* format);
+
+// Duration of the data chunk in AV_TIME_BASE units.
+int64_t wav_duration(const WavFormat* format);
+
+// Widens nb_samples packed 24-bit little endian samples to native int32.
+void wav_unpack_s24(int32_t* dst, const uint8_t* src, int nb_samples);
@@ -0,0 +1,366 @@
+// wave_resample.cpp : Streams a PCM data chunk through the resampler one block at a time.
+//
+
+#include "wave_resample.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "batch.h"
+#include "mapped_reader.h"
+#include "resampler.h"
+#include "wav_copy.h"
+
+extern "C" {
+#include <libavutil/channel_layout.h>
+#include <libavutil/mathematics.h>
+#include <libavutil/samplefmt.h>
+}
+
+// Where blocks of the data chunk come from: fread() into a buffer, or pointers
+// straight into a mapped window of the file.
+typedef struct BLOCK_SOURCE {
+    FILE* file;
+    uint8_t* buffer;
+    uint64_t remaining;
+
+    MappedReader* mapped;
+} BlockSource;
+
+static const uint8_t* next_block(BlockSource* source, size_t want, size_t* got)
+{
+    if (source->mapped)
+        return mapped_reader_next(source->mapped, want, got);
+
+    *got = 0;
+    if (source->remaining == 0)
+        return NULL;
+    if (want > source->remaining)
+        want = (size_t)source->remaining;
+
+    *got = fread(source->buffer, 1, want, source->file);
+    source->remaining = *got == want ? source->remaining - *got : 0;
+    return *got ? source->buffer : NULL;
+}
+
+static int open_resampler(Resampler* resampler, const WavFormat* format, const OutputFormat* out)
+{
+    SwrPoolKey key;
+
+    key.inChannelLayout = format->channelLayout;
+    key.inSampleRate = format->sampleRate;
+    key.inSampleFmt = format->sampleFmt;
+    key.outChannelLayout = out->channelLayout;
+    key.outSampleRate = out->sampleRate;
+    key.outSampleFmt = out->sampleFmt;
+
+    return resampler_open(resampler, &key, out->law);
+}
+
+// The data chunk already holds exactly the requested samples: pass the blocks
+// through untouched.
+static int64_t copy_blocks(BlockSource* source, const WavFormat* format, OutputSink* sink, int block_frames)
+{
+    int64_t written = 0;
+
+    for (;;) {
+        size_t got;
+        const uint8_t* block = next_block(source, (size_t)block_frames * format->blockAlign, &got);
+        if (!block)
+            return written;
+
+        int ret = output_sink_write(sink, block, (int)got);
+        if (ret < 0)
+            return ret;
+        written += ret;
+    }
+}
+
+static int64_t resample_blocks(BlockSource* source, const WavFormat* format, const OutputFormat* out, OutputSink* sink, int block_frames)
+{
+    int src_nb_channels = format->numChannels;
+    int dst_nb_channels = output_format_channels(out);
+    int frame_size = format->blockAlign;
+    int unpack_s24 = format->bytesPerSample == 3;
+    uint8_t* unpacked = NULL;
+    uint8_t** dst_data = NULL;
+    int dst_linesize;
+    int64_t written = 0;
+    int ret;
+
+    if (src_nb_channels <= 0 || format->sampleRate == 0 || block_frames <= 0) {
+        fprintf(stderr, "Unsupported wave format\n");
+        return AVERROR(EINVAL);
+    }
+
+    if (wav_format_matches(format, out))
+        return copy_blocks(source, format, sink, block_frames);
+
+    Resampler resampler;
+    ret = open_resampler(&resampler, format, out);
+    if (ret < 0)
+        return ret;
+
+    // Both buffers are sized once for a full block; the final drain only ever
+    // needs what is left in the filter delay, which is less.
+    int dst_nb_samples = resampler_get_out_samples(&resampler, block_frames);
+    if (unpack_s24)
+        unpacked = (uint8_t*)av_malloc((size_t)block_frames * src_nb_channels * sizeof(int32_t));
+    ret = av_samples_alloc_array_and_samples(&dst_data, &dst_linesize, dst_nb_channels, dst_nb_samples, out->sampleFmt, 0);
+    if ((unpack_s24 && !unpacked) || ret < 0) {
+        fprintf(stderr, "Could not allocate sample buffers\n");
+        written = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    for (;;) {
+        size_t got;
+        const uint8_t* block = next_block(source, (size_t)block_frames * frame_size, &got);
+        const uint8_t** in = NULL;
+        int in_nb_samples = (int)(got / frame_size);
+
+        if (block) {
+            in = &block;
+            if (unpack_s24) {
+                wav_unpack_s24((int32_t*)unpacked, block, in_nb_samples * src_nb_channels);
+                in = (const uint8_t**)&unpacked;
+            }
+        }
+
+        // A NULL input drains the samples still held in the filter.
+        ret = resampler_convert(&resampler, dst_data, dst_nb_samples, in, in_nb_samples);
+        if (ret < 0) {
+            fprintf(stderr, "Error while converting\n");
+            written = ret;
+            goto end;
+        }
+        if (ret == 0 && !in)
+            break;
+
+        ret = output_sink_write(sink, dst_data[0], (size_t)ret * output_format_block_align(out));
+        if (ret < 0) {
+            written = ret;
+            goto end;
+        }
+        written += ret;
+    }
+
+end:
+    av_free(unpacked);
+    if (dst_data)
+        av_freep(&dst_data[0]);
+    av_freep(&dst_data);
+    resampler_close(&resampler);
+
+    return written;
+}
+
+int64_t resample_wave_stream(FILE* infile, const WavFormat* format, const OutputFormat* out, OutputSink* sink, int block_frames)
+{
+    BlockSource source = {};
+
+    if (block_frames <= 0 || format->blockAlign == 0)
+        return AVERROR(EINVAL);
+
+    source.file = infile;
+    source.remaining = format->dataSize;
+    source.buffer = (uint8_t*)av_malloc((size_t)block_frames * format->blockAlign);
+    if (!source.buffer) {
+        fprintf(stderr, "Could not allocate sample buffers\n");
+        return AVERROR(ENOMEM);
+    }
+
+    int64_t ret = resample_blocks(&source, format, out, sink, block_frames);
+    av_free(source.buffer);
+
+    return ret;
+}
+
+int64_t resample_wave_mapped(FILE* infile, const WavFormat* format, const OutputFormat* out, OutputSink* sink, int block_frames)
+{
+    BlockSource source = {};
+    MappedReader reader;
+
+    int ret = mapped_reader_open(&reader, infile, format->dataOffset, format->dataSize);
+    if (ret < 0)
+        return ret;
+
+    source.mapped = &reader;
+    int64_t written = resample_blocks(&source, format, out, sink, block_frames);
+    mapped_reader_close(&reader);
+
+    return written;
+}
+
+// One slice of the data chunk for resample_wave_parallel().
+typedef struct RESAMPLE_TASK {
+    // Input frames read, including pre-roll and overlap.
+    int64_t readFrom;
+    int64_t readTo;
+
+    // Output frames of this task's own resampler that belong to the result;
+    // keepTo is INT64_MAX for the last task, which drains to the end.
+    int64_t keepFrom;
+    int64_t keepTo;
+    int64_t pos;
+    int align;
+
+    // Kept output, growable buffer.
+    OutputSink result;
+    int64_t ret;
+    int done;
+} ResampleTask;
+
+// Drops the pre-roll and overlap output.
+static int trim_write(void* opaque, int64_t offset, const uint8_t* buf, int size)
+{
+    ResampleTask* task = (ResampleTask*)opaque;
+    int64_t frames = size / task->align;
+    int64_t from = std::max(task->pos, task->keepFrom);
+    int64_t to = std::min(task->pos + frames, task->keepTo);
+
+    (void)offset;
+    if (to > from) {
+        int64_t bytes = (to - from) * task->align;
+        if (output_sink_write(&task->result, buf + (from - task->pos) * task->align, (size_t)bytes) != bytes)
+            return -1;
+    }
+
+    task->pos += frames;
+    return size;
+}
+
+static void run_task(ResampleTask* task, FILE* infile, const WavFormat* format, const OutputFormat* out, int block_frames)
+{
+    BlockSource source = {};
+    MappedReader reader;
+    OutputSink trim;
+
+    int64_t offset = format->dataOffset + task->readFrom * format->blockAlign;
+    uint64_t size = (uint64_t)(task->readTo - task->readFrom) * format->blockAlign;
+    if (task->keepTo == INT64_MAX)
+        size = format->dataSize - (uint64_t)task->readFrom * format->blockAlign;
+
+    task->ret = mapped_reader_open(&reader, infile, offset, size);
+    if (task->ret < 0)
+        return;
+
+    output_sink_init_callback(&trim, trim_write, task);
+    source.mapped = &reader;
+    task->ret = resample_blocks(&source, format, out, &trim, block_frames);
+    mapped_reader_close(&reader);
+}
+
+int64_t resample_wave_parallel(FILE* infile, const WavFormat* format, const OutputFormat* out, OutputSink* sink, int block_frames, int threads)
+{
+    if (format->blockAlign == 0 || format->sampleRate == 0 || block_frames <= 0)
+        return AVERROR(EINVAL);
+
+    // Output frame k of a resampler started at input frame start lines up with
+    // output frame k + start * out / in of the single pass only when start is a
+    // multiple of step, where the output grid comes back to phase 0.
+    int64_t in_rate = format->sampleRate;
+    int64_t out_rate = out->sampleRate;
+    int64_t gcd = av_gcd(in_rate, out_rate);
+    int64_t step = in_rate / gcd;
+    int64_t overlap = RESAMPLE_OVERLAP_TAPS * std::max<int64_t>(1, (in_rate + out_rate - 1) / out_rate);
+    int64_t preroll = (overlap + step - 1) / step * step;
+    int64_t task_frames = (RESAMPLE_TASK_SECONDS * in_rate + step - 1) / step * step;
+    int64_t frames = (int64_t)(format->dataSize / format->blockAlign);
+    int64_t count = (frames + task_frames - 1) / task_frames;
+
+    if (threads <= 0)
+        threads = batch_default_threads();
+    if (threads == 1 || count < 2 || wav_format_matches(format, out))
+        return resample_wave_mapped(infile, format, out, sink, block_frames);
+
+    std::vector<ResampleTask> tasks((size_t)count);
+    for (int64_t i = 0; i < count; i++) {
+        ResampleTask* task = &tasks[(size_t)i];
+        int64_t start = i * task_frames;
+        int64_t end = std::min(start + task_frames, frames);
+        int64_t read_from = std::max<int64_t>(0, start - preroll);
+
+        task->readFrom = read_from;
+        task->readTo = std::min(end + overlap, frames);
+        task->keepFrom = (start - read_from) / step * (out_rate / gcd);
+        task->keepTo = i == count - 1 ? INT64_MAX : (end - read_from) / step * (out_rate / gcd);
+        task->pos = 0;
+        task->align = output_format_block_align(out);
+        output_sink_init_buffer(&task->result, NULL, 0);
+        task->ret = 0;
+        task->done = 0;
+    }
+
+    // Workers run ahead of the writer by at most window tasks, which bounds
+    // the memory held in finished results.
+    std::mutex mutex;
+    std::condition_variable cond;
+    int64_t next = 0;
+    int64_t cursor = 0;
+    int64_t window = threads + 2;
+    bool abort = false;
+
+    auto worker = [&]() {
+        for (;;) {
+            int64_t i;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cond.wait(lock, [&]() { return abort || next >= count || next < cursor + window; });
+                if (abort || next >= count)
+                    return;
+                i = next++;
+            }
+
+            run_task(&tasks[(size_t)i], infile, format, out, block_frames);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                tasks[(size_t)i].done = 1;
+            }
+            cond.notify_all();
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int i = 0; i < threads; i++)
+        pool.emplace_back(worker);
+
+    int64_t written = 0;
+    for (int64_t i = 0; i < count; i++) {
+        ResampleTask* task = &tasks[(size_t)i];
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [&]() { return task->done != 0; });
+        }
+
+        int64_t ret = task->ret;
+        if (ret >= 0)
+            ret = output_sink_write(sink, task->result.data, task->result.size);
+        av_freep(&task->result.data);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            cursor = i + 1;
+            if (ret < 0)
+                abort = true;
+        }
+        cond.notify_all();
+
+        if (ret < 0) {
+            written = ret;
+            break;
+        }
+        written += ret;
+    }
+
+    for (std::thread& t : pool)
+        t.join();
+    for (ResampleTask& task : tasks)
+        av_freep(&task.result.data);
+
+    return written;
+}
@@ -0,0 +1,53 @@
+// wave_resample.h : Block-wise resampling of a PCM WAV data chunk.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+
+#include "output_format.h"
+#include "output_sink.h"
+#include "wav_parser.h"
+
+// Input frames read and converted per resampler_convert() call.
+#define RESAMPLE_BLOCK_FRAMES 16384
+
+// Input seconds per task of resample_wave_parallel().
+#define RESAMPLE_TASK_SECONDS 10
+
+// Input frames of real context resample_wave_parallel() feeds on each side of
+// a task, per unit of decimation ratio. swr's default filter reaches 16 taps
+// either way at unity ratio and the polyphase engine's 24, both stretched by
+// the ratio when downsampling.
+#define RESAMPLE_OVERLAP_TAPS 64
+
+// Data chunks at least this large are read through a mapping rather than fread().
+#define RESAMPLE_MMAP_THRESHOLD (64 * 1024 * 1024)
+
+// Reads the data chunk described by format from infile, which must be positioned
+// at its first byte, in blocks of block_frames and writes it converted to out to
+// sink as it goes, so memory use does not depend on the input length. A chunk
+// that already matches out is copied as is. Returns the number of bytes written
+// or a negative AVERROR.
+int64_t resample_wave_stream(FILE* infile, const WavFormat* format, const OutputFormat* out, OutputSink* sink, int block_frames);
+
+// Same as resample_wave_stream() but hands the resampler pointers straight into
+// a sequentially mapped window of infile, so the data is never copied.
+int64_t resample_wave_mapped(FILE* infile, const WavFormat* format, const OutputFormat* out, OutputSink* sink, int block_frames);
+
+// resample_wave_mapped() spread over threads workers (0 for one per core). The
+// data chunk is cut into tasks that start on input frames where the output
+// sample grid restarts (multiples of in_rate / gcd(in_rate, out_rate)), and each
+// task resamples with its own resampler from a pre-roll before its start to an
+// overlap past its end, keeping only its own output samples. Every kept sample
+// is then computed from the same input with the same filter phase as in a single
+// pass. The result is bit-exact with the polyphase engine (without dither, whose
+// noise restarts with each task), and with swresample when it steps through the
+// ratio exactly, which its exact_rational mode does whenever out_rate / gcd
+// fits its 1024-entry phase table (every common pair).
+// Otherwise a task's phase can differ from the single pass by less than one
+// table entry, an error below the filter's own interpolation error. Results are
+// written in order, with at most threads + 2 of them held in memory. Inputs too
+// short for two tasks or already in the output format take the single pass.
+int64_t resample_wave_parallel(FILE* infile, const WavFormat* format, const OutputFormat* out, OutputSink* sink, int block_frames, int threads);
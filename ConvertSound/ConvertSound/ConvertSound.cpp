@@ -2,262 +2,476 @@
 //
 
 #include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <glob.h>
+#include <sys/stat.h>
+#endif
 
 extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
-#include <libavfilter/buffersink.h>
-#include <libavfilter/buffersrc.h>
 #include <libavutil/channel_layout.h>
 #include <libavutil/opt.h>
 #include <libavutil/pixdesc.h>
+#include <libavutil/time.h>
 #include <libswresample/swresample.h>
 }
 
+#include "audio_encoder.h"
+#include "batch.h"
+#include "decode_session.h"
+#include "input_open.h"
+#include "resampler.h"
+#include "segment_decode.h"
+#include "wav_copy.h"
+#include "wav_header.h"
+
 #define AUDIO_INBUF_SIZE 20480
-#define WRITE_U32(buf, x) *(buf)     = (unsigned char)((x)&0xff);\
-                          *((buf)+1) = (unsigned char)(((x)>>8)&0xff);\
-                          *((buf)+2) = (unsigned char)(((x)>>16)&0xff);\
-                          *((buf)+3) = (unsigned char)(((x)>>24)&0xff);
-#define WRITE_U16(buf, x) *(buf)     = (unsigned char)((x)&0xff);\
-                          *((buf)+1) = (unsigned char)(((x)>>8)&0xff);
-
-static int decode_audio(AVCodecContext* dec_ctx, AVFrame* frame, AVPacket* pkt, SwrContext* swr_ctx, FILE* outfile)
-{
-    int ret, data_size;
-    int dst_nb_samples = 0, dst_linesize;
-    uint8_t** dst_data = NULL;
 
-    ret = avcodec_send_packet(dec_ctx, pkt);
+// Shared by every batch worker, read only.
+typedef struct CONVERT_SETTINGS {
+    OutputFormat format;
+    InputOptions input;
+    enum WavContainer container;
+    // Encoder after the conversion, AUDIO_CODEC_PCM for none, and the
+    // libavformat container in place of the hand-built WAV header.
+    enum AudioCodec codec;
+    enum AudioContainer muxer;
+    int writerFlags;
+    bool stats;
+
+    // Segments a long input is split into, 0 for one per core, 1 for a single pass.
+    int segments;
+    // Frame threads for decoders that support them, 0 for one per core.
+    int decodeThreads;
+} ConvertSettings;
+
+// Standard output cannot seek back to patch the header, so it gets the final
+// size up front when the demuxer knows the duration, and the streaming
+// 0xFFFFFFFF sizes otherwise. Unbuffered, every decoded frame reaches the
+// reader as soon as it is converted.
+static void init_stdout_sink(OutputSink* sink)
+{
+#ifdef _WIN32
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    setvbuf(stdout, NULL, _IONBF, 0);
+    output_sink_init_file(sink, stdout);
+}
 
-    if (ret < 0) {
-        fprintf(stderr, "Error submitting the packet to the decoder %d \n", ret);
-        return ret;
+static int convert_sound(void* opaque, const char* filename, const char* outname, double* audio_seconds)
+{
+    const ConvertSettings* settings = (const ConvertSettings*)opaque;
+    const OutputFormat* out = &settings->format;
+    int64_t start = av_gettime_relative();
+    int ret = -1;
+    FileWriter writer;
+    bool writer_open = false;
+    AVPacket* pkt = NULL;
+    DecodeSession* session = NULL;
+    AVFormatContext* format = NULL;
+    AudioEncoder* encoder = NULL;
+
+    bool to_stdout = !strcmp(outname, "-");
+    bool muxed = audio_encoder_needed(settings->codec, settings->muxer);
+    bool can_copy = !to_stdout && strcmp(filename, "-") != 0 && !muxed &&
+                    (settings->container == WAV_CONTAINER_AUTO || settings->container == WAV_CONTAINER_RIFF);
+
+    *audio_seconds = 0;
+
+    int64_t copied;
+    ret = can_copy ? wav_copy_file(filename, outname, out, &copied) : 0;
+    if (ret != 0) {
+        *audio_seconds = (double)copied / ((double)out->sampleRate * output_format_block_align(out));
+        return ret < 0 ? -1 : 0;
     }
+    ret = -1;
+
+    if (input_open_file(&format, filename, &settings->input) < 0)
+        return -1;
+
+    {
+        int stream_index = input_find_audio_stream(format, filename, &settings->input);
+        if (stream_index < 0)
+            goto end;
+
+        int64_t opened = av_gettime_relative();
+
+        AVStream* audio_stream = format->streams[stream_index];
+        AVCodecParameters* params = audio_stream->codecpar;
+        int segments = settings->segments == 1 ? 1 : segment_decode_count(format, settings->segments);
+
+        if (segments == 1 && decode_session_open(&session, params, out, settings->decodeThreads) < 0)
+            goto end;
+
+        av_dump_format(format, 0, filename, 0);
+
+        int64_t expected = output_format_data_size(out, format->duration);
+        OutputSink sink;
+        WavHeader header;
+        uint64_t prelim_size = WAV_HEADER_UNKNOWN_SIZE;
+
+        wav_header_init(&header, out, settings->container, expected);
+        if (to_stdout) {
+            init_stdout_sink(&sink);
+            // A pipe is never patched, so only a duration read from timestamps
+            // goes into the header; one estimated from the bitrate would not
+            // match what is streamed.
+            if (expected > 0 && format->duration_estimation_method == AVFMT_DURATION_FROM_PTS)
+                prelim_size = expected;
+        }
+        else {
+            if (file_writer_open(&writer, outname, settings->writerFlags) < 0) {
+                fprintf(stderr, "Could not open destination file %s\n", outname);
+                goto end;
+            }
+            writer_open = true;
 
-    while (ret >= 0) {
-        ret = avcodec_receive_frame(dec_ctx, frame);
-        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
-            return 0;
-        else if (ret < 0) {
-            fprintf(stderr, "Error duirng decoding \n");
-            return ret;
+            if (expected > 0 && !muxed)
+                file_writer_preallocate(&writer, expected + header.size);
+            output_sink_init_writer(&sink, &writer);
         }
-        data_size = av_get_bytes_per_sample(dec_ctx->sample_fmt);
-        if (data_size < 0) {
-            fprintf(stderr, "Failed to calculate data size\n");
-            exit(1);
+
+        // Encoded or muxed output goes through libavformat, which writes the
+        // container header itself.
+        OutputSink* pcm_sink = &sink;
+        if (muxed) {
+            if (audio_encoder_open(&encoder, settings->codec, settings->muxer, out, &sink, !to_stdout) < 0)
+                goto end;
+            pcm_sink = audio_encoder_input(encoder);
+        }
+        else
+            wav_header_write(&header, &sink, prelim_size);
+        uint64_t sound_length = 0;
+
+        if (segments > 1) {
+            int64_t length = segment_decode_run(filename, &settings->input, params->sample_rate, out, format->duration,
+                                               segments, pcm_sink);
+            if (length < 0)
+                goto end;
+            sound_length = length;
         }
+        else {
+            pkt = av_packet_alloc();
+            if (!pkt)
+                goto end;
+
+            // A corrupt packet is skipped, a failed write ends the conversion.
+            while (!pcm_sink->failed && av_read_frame(format, pkt) >= 0) {
+                if (pkt->stream_index == stream_index) {
+                    ret = decode_session_send_packet(session, pkt, pcm_sink);
+                    if (ret > 0)
+                    {
+                        sound_length += ret;
+                    }
+                }
+
+                av_packet_unref(pkt);
+            }
 
-        if (dst_nb_samples == 0) {
-            dst_nb_samples = av_rescale_rnd(frame->nb_samples, 8000, 8000, AV_ROUND_UP);
-            ret = av_samples_alloc_array_and_samples(&dst_data, &dst_linesize, 1, dst_nb_samples, AV_SAMPLE_FMT_S16, 0);
-            ret = av_samples_alloc(dst_data, &dst_linesize, 1, dst_nb_samples, AV_SAMPLE_FMT_S16, 1);
+            if (!pcm_sink->failed) {
+                ret = decode_session_flush(session, pcm_sink);
+                if (ret > 0)
+                {
+                    sound_length += ret;
+                }
+            }
         }
-        ret = swr_convert(swr_ctx, dst_data, dst_nb_samples, (const uint8_t**)frame->data, frame->nb_samples);        
 
-        int dst_bufsize = av_samples_get_buffer_size(&dst_linesize, 1, ret, AV_SAMPLE_FMT_S16, 1);
-        int size = fwrite(dst_data[0], 1, dst_bufsize, outfile);
-        return size;
+        if (pcm_sink->failed)
+            ret = -1;
+        else if (encoder && audio_encoder_finish(encoder) < 0)
+            ret = -1;
+        else if (to_stdout)
+            ret = wav_header_pad(&header, &sink, sound_length) == 0 && fflush(stdout) == 0 ? 0 : -1;
+        else
+            ret = wav_header_finalize(&header, &sink, sound_length) == 0 ? 0 : -1;
+        *audio_seconds = (double)sound_length / ((double)out->sampleRate * output_format_block_align(out));
+
+        if (settings->stats)
+            fprintf(stderr, "%s: format %s, open: %.3f ms, total: %.3f ms\n", filename, format->iformat->name,
+                    (opened - start) / 1000.0, (av_gettime_relative() - start) / 1000.0);
     }
 
-    return 0;
+end:
+    if (writer_open && file_writer_close(&writer) < 0)
+        ret = -1;
+    decode_session_free(&session);
+    audio_encoder_free(&encoder);
+    av_packet_free(&pkt);
+    avformat_close_input(&format);
+
+    return ret;
 }
 
-static int write_prelim_header(FILE* outfile, unsigned char* headbuf)
+static bool is_directory(const char* path)
 {
-    int bytespersec = 8000 * 16 / 8;
-    int align = 16 / 8;
-    int samplesize = 16;
-    unsigned int size = 0x7fffffff;
-
-    memcpy(headbuf, "RIFF", 4);
-    WRITE_U32(headbuf + 4, size - 8);
-    memcpy(headbuf + 8, "WAVE", 4);
-    memcpy(headbuf + 12, "fmt ", 4);
-    WRITE_U32(headbuf + 16, 16);
-    WRITE_U16(headbuf + 20, 1);  /* format */
-    WRITE_U16(headbuf + 22, 1);
-    WRITE_U32(headbuf + 24, 8000);
-    WRITE_U32(headbuf + 28, bytespersec);
-    WRITE_U16(headbuf + 32, align);
-    WRITE_U16(headbuf + 34, samplesize);
-    memcpy(headbuf + 36, "data", 4);
-    WRITE_U32(headbuf + 40, size - 44);
-
-    if (fwrite(headbuf, 1, 44, outfile) != 44)
-    {
-        fprintf(stderr, "ERROR: Failed to write wav header: \n");
-        return -1;
-    }
-
-    return 0;
+#ifdef _WIN32
+    DWORD attributes = GetFileAttributesA(path);
+    return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+#endif
 }
 
-static int rewrite_header(FILE* outfile, unsigned char* headbuf, unsigned int written)
+// Appends the regular files matching a wildcard pattern.
+static void expand_glob(const std::string& pattern, std::vector<std::string>& files)
 {
-    unsigned int length = written;
-
-    length += 44;
-
-    WRITE_U32(headbuf + 4, length - 8);
-    WRITE_U32(headbuf + 40, length - 44);
-    if (fseek(outfile, 0, SEEK_SET) != 0)
-    {
-        fprintf(stderr, "ERROR: Failed to seek on seekable file: \n");
-        return 1;
-    }
-
-    if (fwrite(headbuf, 1, 44, outfile) != 44)
-    {
-        fprintf(stderr, "ERROR: Failed to write wav header: \n");
-        return 1;
+#ifdef _WIN32
+    std::string dir;
+    size_t slash = pattern.find_last_of("\\/");
+    if (slash != std::string::npos)
+        dir = pattern.substr(0, slash + 1);
+
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA(pattern.c_str(), &data);
+    if (find == INVALID_HANDLE_VALUE)
+        return;
+    do {
+        if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+            files.push_back(dir + data.cFileName);
+    } while (FindNextFileA(find, &data));
+    FindClose(find);
+#else
+    glob_t matches;
+    if (glob(pattern.c_str(), 0, NULL, &matches) != 0)
+        return;
+    for (size_t i = 0; i < matches.gl_pathc; i++) {
+        if (!is_directory(matches.gl_pathv[i]))
+            files.push_back(matches.gl_pathv[i]);
     }
-    return 0;
+    globfree(&matches);
+#endif
 }
 
-static int convert_sound(const char* filename)
+// A batch input is a directory, @list-file with one path per line, a wildcard
+// pattern or a plain file name.
+static void expand_input(const char* arg, std::vector<std::string>& files)
 {
-    const AVCodec* codec;
-    AVCodecContext* c = NULL;
-    int ret;
-    FILE* f, * outfile;
-    uint8_t inbuf[AUDIO_INBUF_SIZE + AV_INPUT_BUFFER_PADDING_SIZE];
-    AVPacket* pkt;
-    AVFrame* decoded_frame = NULL;
-    static struct SwrContext* swr_ctx;
-
-    pkt = av_packet_alloc();
-
-    AVFormatContext* format = avformat_alloc_context();
-
-    ret = avformat_open_input(&format, filename, NULL, NULL);
-    if (ret != 0) {
-        fprintf(stderr, "Could not open file '%s'\n", filename);
-        return -1;
-    }
-    if (avformat_find_stream_info(format, NULL) < 0) {
-        fprintf(stderr, "Could not retrieve stream info from file '%s'\n", filename);
-        return -1;
-    }
-
-    int stream_index = -1;
-    for (int i = 0; i < format->nb_streams; i++) {
-        if (format->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
-            stream_index = i;
-            break;
+    if (arg[0] == '@') {
+        std::ifstream list(arg + 1);
+        std::string line;
+        while (std::getline(list, line)) {
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            if (!line.empty())
+                files.push_back(line);
         }
     }
-    if (stream_index == -1) {
-        fprintf(stderr, "Could not retrieve audio stream from file '%s'\n", filename);
-        return -1;
-    }
-
-    AVStream* audio_stream = format->streams[stream_index];
-    AVCodecParameters* params = audio_stream->codecpar;
+    else if (is_directory(arg))
+        expand_glob(std::string(arg) + "/*", files);
+    else if (strpbrk(arg, "*?"))
+        expand_glob(arg, files);
+    else
+        files.push_back(arg);
+}
 
-    codec = avcodec_find_decoder(params->codec_id);
-    if (!codec) {
-        fprintf(stderr, "Codec not found\n");
-        return -1;
-    }
+static std::string batch_output_name(const std::string& outdir, const std::string& input, const char* extension)
+{
+    size_t slash = input.find_last_of("\\/");
+    std::string name = slash == std::string::npos ? input : input.substr(slash + 1);
+    size_t dot = name.find_last_of('.');
+    if (dot != std::string::npos && dot > 0)
+        name.resize(dot);
 
-    c = avcodec_alloc_context3(codec);
-    if (!c) {
-        fprintf(stderr, "Could not allocate audio codec context\n");
-        return -1;
-    }
+    return outdir + "/" + name + "_result" + extension;
+}
 
-    if (avcodec_open2(c, codec, NULL) < 0) {
-        fprintf(stderr, "Could not open codec\n");
-        return -1;
+static int run_batch(const std::vector<std::string>& inputs, const std::string& outdir, int threads, ConvertSettings* settings)
+{
+    std::vector<std::string> outputs;
+    std::vector<BatchJob> jobs(inputs.size());
+    const char* extension = audio_encoder_extension(settings->codec, settings->muxer);
+
+    for (const std::string& input : inputs)
+        outputs.push_back(batch_output_name(outdir, input, extension));
+    for (size_t i = 0; i < inputs.size(); i++) {
+        jobs[i].input = inputs[i].c_str();
+        jobs[i].output = outputs[i].c_str();
     }
 
-    swr_ctx = swr_alloc();
-
-    if (!swr_ctx) {
-        fprintf(stderr, "Could not allocate resampler context\n");
-        return -1;
+    if (threads <= 0)
+        threads = batch_default_threads();
+
+#ifdef _WIN32
+    _mkdir(outdir.c_str());
+#else
+    mkdir(outdir.c_str(), 0777);
+#endif
+
+    // Per-file stream dumps from many threads would only interleave, and the
+    // workers already keep every core busy.
+    av_log_set_level(AV_LOG_ERROR);
+    settings->decodeThreads = 1;
+
+    BatchSummary summary;
+    batch_run(jobs.data(), (int)jobs.size(), threads, convert_sound, settings, &summary);
+
+    for (const BatchJob& job : jobs) {
+        if (job.result < 0)
+            printf("FAILED %s\n", job.input);
+        else
+            printf("ok     %s -> %s (%.2f s, %.1fx realtime)\n", job.input, job.output,
+                   job.seconds, job.seconds > 0 ? job.audio_seconds / job.seconds : 0.0);
     }
 
-    av_opt_set_int(swr_ctx, "in_channel_layout", params->channel_layout, 0);
-    av_opt_set_int(swr_ctx, "in_sample_rate", params->sample_rate, 0);
-    av_opt_set_sample_fmt(swr_ctx, "in_sample_fmt", static_cast<AVSampleFormat>(params->format), 0);
-
-    av_opt_set_int(swr_ctx, "out_channel_layout", AV_CH_LAYOUT_MONO, 0);
-    av_opt_set_int(swr_ctx, "out_sample_rate", 8000, 0);
-    av_opt_set_sample_fmt(swr_ctx, "out_sample_fmt", AV_SAMPLE_FMT_S16, 0);
-    swr_init(swr_ctx);
-
-    av_dump_format(format, 0, filename, 0);
-
-    decoded_frame = av_frame_alloc();
-    if (decoded_frame == NULL) {
-        fprintf(stderr, "Could not allocate frame\n");
-        ret = AVERROR(ENOMEM);
-        return -1;
-    }
+    printf("%d files, %d failed, %d threads, %.2f s: %.1f files/s, %.0f s of audio, %.1fx realtime\n",
+           summary.files, summary.failed, threads, summary.wall_seconds,
+           summary.wall_seconds > 0 ? summary.files / summary.wall_seconds : 0.0,
+           summary.audio_seconds,
+           summary.wall_seconds > 0 ? summary.audio_seconds / summary.wall_seconds : 0.0);
 
-    av_init_packet(pkt);
-    pkt->data = inbuf;
-    pkt->size = AUDIO_INBUF_SIZE + AV_INPUT_BUFFER_PADDING_SIZE;
-    pkt->stream_index = stream_index;
+    return summary.failed ? 1 : 0;
+}
 
-    int pkt_i = 0;
+static void usage(const char* name)
+{
+    fprintf(stderr, "Usage: %s [options] <input file> [<output file>]\n", name);
+    fprintf(stderr, "       (- reads standard input or writes standard output; default output result.wav,\n");
+    fprintf(stderr, "        result.<ext> with --codec or --muxer)\n");
+    fprintf(stderr, "       %s [options] --batch [-j <threads>] [-o <output dir>] <dir|@list|glob|file>...\n", name);
+    fprintf(stderr, "Format options (default 8000 Hz mono s16):\n");
+    fprintf(stderr, "  --rate <hz>          output sample rate\n");
+    fprintf(stderr, "  --layout <layout>    channel layout or count, e.g. mono, stereo, 2\n");
+    fprintf(stderr, "  --format <fmt>       sample format: u8, s16, s32, flt, or mulaw/alaw for G.711\n");
+    fprintf(stderr, "  --resampler <r>      swr, or native polyphase for 44.1/48/16 kHz to 8 kHz\n");
+    fprintf(stderr, "  --dither <d>         none, tpdf or shaped, for native s16 output\n");
+    fprintf(stderr, "  --mix <gains>        native downmix gains per output channel, e.g. 0.7,0.3 or 1,0/0,1\n");
+    fprintf(stderr, "Input options:\n");
+    fprintf(stderr, "  --fast               bounded probing, skip stream info when the header suffices\n");
+    fprintf(stderr, "  --hint <demuxer>     input format instead of probing, e.g. mp3, mov, wav\n");
+    fprintf(stderr, "  --stats              print open and total time per file\n");
+    fprintf(stderr, "  --segments <n>       decode a long input as n time segments in parallel, 0 for one per core\n");
+    fprintf(stderr, "Output options:\n");
+    fprintf(stderr, "  --container <c>      auto (RIFF, RF64 past 4 GB), wav, rf64 or w64\n");
+    fprintf(stderr, "  --muxer <c>          write through libavformat instead: wav, au, caf, raw or mkv\n");
+    fprintf(stderr, "  --codec <c>          pcm, or encode to flac, adpcm_ima, adpcm_ms, g722 or g726 (mono)\n");
+    fprintf(stderr, "                       g722 is always 16000 Hz, --rate does not apply\n");
+    fprintf(stderr, "  --direct             write with O_DIRECT, bypassing the page cache (Linux)\n");
+}
 
-    fopen_s(&f, filename, "rb");
-    if (!f) {
-        fprintf(stderr, "Could not open %s\n", filename);
-        return -1;
+int main(int argc, char** argv)
+{
+    ConvertSettings settings;
+    const char* rate = NULL;
+    const char* layout = NULL;
+    const char* sample_fmt = NULL;
+    enum SampleDither dither = SAMPLE_DITHER_NONE;
+    SampleMixMatrix matrix;
+    bool has_matrix = false;
+    int i = 1;
+
+    output_format_init(&settings.format);
+    input_options_init(&settings.input);
+    settings.container = WAV_CONTAINER_AUTO;
+    settings.codec = AUDIO_CODEC_PCM;
+    settings.muxer = AUDIO_CONTAINER_DEFAULT;
+    settings.writerFlags = 0;
+    settings.stats = false;
+    settings.segments = 1;
+    settings.decodeThreads = 0;
+
+    for (; i < argc; i++) {
+        if (!strcmp(argv[i], "--fast"))
+            settings.input.fast = 1;
+        else if (!strcmp(argv[i], "--stats"))
+            settings.stats = true;
+        else if (!strcmp(argv[i], "--direct"))
+            settings.writerFlags |= FILE_WRITER_DIRECT;
+        else if (i + 1 >= argc)
+            break;
+        else if (!strcmp(argv[i], "--rate"))
+            rate = argv[++i];
+        else if (!strcmp(argv[i], "--layout"))
+            layout = argv[++i];
+        else if (!strcmp(argv[i], "--format"))
+            sample_fmt = argv[++i];
+        else if (!strcmp(argv[i], "--segments"))
+            settings.segments = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--resampler")) {
+            enum ResamplerEngine engine;
+            if (resampler_parse_engine(argv[++i], &engine) < 0)
+                return 1;
+            resampler_set_engine(engine);
+        }
+        else if (!strcmp(argv[i], "--dither")) {
+            if (sample_mix_parse_dither(argv[++i], &dither) < 0)
+                return 1;
+        }
+        else if (!strcmp(argv[i], "--mix")) {
+            if (sample_mix_parse_matrix(argv[++i], &matrix) < 0)
+                return 1;
+            has_matrix = true;
+        }
+        else if (!strcmp(argv[i], "--hint"))
+            settings.input.formatHint = argv[++i];
+        else if (!strcmp(argv[i], "--container")) {
+            if (wav_header_parse_container(argv[++i], &settings.container) < 0)
+                return 1;
+        }
+        else if (!strcmp(argv[i], "--muxer")) {
+            if (audio_container_parse(argv[++i], &settings.muxer) < 0)
+                return 1;
+        }
+        else if (!strcmp(argv[i], "--codec")) {
+            if (audio_codec_parse(argv[++i], &settings.codec) < 0)
+                return 1;
+        }
+        else
+            break;
     }
 
-    fopen_s(&outfile, "result.wav", "wb");
-    if (!outfile) {
-        av_free(c);
-        return -1;
+    if (i >= argc) {
+        usage(argv[0]);
+        exit(0);
     }
-
-    unsigned char headbuf[44];
-    write_prelim_header(outfile, headbuf);
-    unsigned int sound_length = 0;
-
-    while (av_read_frame(format, pkt) >= 0) {
-        if (pkt->stream_index == stream_index) {
-            ret = decode_audio(c, decoded_frame, pkt, swr_ctx, outfile);
-            if (ret > 0)
-            {
-                sound_length += ret;
-            }
+    if (output_format_parse(&settings.format, rate, layout, sample_fmt) < 0)
+        return 1;
+    if (settings.codec != AUDIO_CODEC_PCM) {
+        if (settings.format.law != G711_NONE) {
+            fprintf(stderr, "G.711 output is PCM, it does not go through --codec\n");
+            return 1;
         }
-        pkt_i++;
-
-        av_packet_unref(pkt);
+        settings.format.sampleFmt = audio_codec_sample_fmt(settings.codec, settings.format.sampleFmt);
+        settings.format.sampleRate = audio_codec_sample_rate(settings.codec, settings.format.sampleRate);
     }
+    if (resampler_set_mix(dither, has_matrix ? &matrix : NULL, &settings.format) < 0)
+        return 1;
 
-    rewrite_header(outfile, headbuf, sound_length);
-
-    fclose(outfile);
-    fclose(f);
-    avcodec_free_context(&c);
-    av_frame_free(&decoded_frame);
-    av_packet_free(&pkt);
-    avformat_close_input(&format);
-
-    return 0;
-}
-
-int main(int argc, char** argv)
-{
-    const char* filename;
-
-    if (argc <= 1) {
-        fprintf(stderr, "Usage: %s <input file>\n", argv[0]);
-        exit(0);
+    if (strcmp(argv[i], "--batch") != 0) {
+        double audio_seconds;
+        std::string outname = i + 1 < argc ? argv[i + 1] : std::string("result") + audio_encoder_extension(settings.codec, settings.muxer);
+        return convert_sound(&settings, argv[i], outname.c_str(), &audio_seconds) < 0 ? 1 : 0;
     }
 
-    filename = argv[1];
+    std::vector<std::string> inputs;
+    std::string outdir = ".";
+    int threads = 0;
+
+    for (i++; i < argc; i++) {
+        if (!strcmp(argv[i], "-j") && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+            outdir = argv[++i];
+        else
+            expand_input(argv[i], inputs);
+    }
 
-    convert_sound(filename);
+    if (inputs.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
 
-    return 0;
+    return run_batch(inputs, outdir, threads, &settings);
 }
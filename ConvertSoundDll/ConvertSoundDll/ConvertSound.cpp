@@ -1,372 +1,516 @@
 #include "pch.h"
+#include "ConvertSound.h"
 #include <iostream>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
-#include <libavfilter/buffersink.h>
-#include <libavfilter/buffersrc.h>
 #include <libavutil/channel_layout.h>
 #include <libavutil/opt.h>
 #include <libavutil/pixdesc.h>
 #include <libswresample/swresample.h>
 }
 
+#include "audio_encoder.h"
+#include "avio_input.h"
+#include "batch.h"
+#include "compat.h"
+#include "decode_session.h"
+#include "input_open.h"
+#include "output_sink.h"
+#include "wav_copy.h"
+#include "wav_header.h"
+#include "wave_resample.h"
+
 #define AUDIO_INBUF_SIZE 20480
-#define WRITE_U32(buf, x) *(buf)     = (unsigned char)((x)&0xff);\
-                          *((buf)+1) = (unsigned char)(((x)>>8)&0xff);\
-                          *((buf)+2) = (unsigned char)(((x)>>16)&0xff);\
-                          *((buf)+3) = (unsigned char)(((x)>>24)&0xff);
-#define WRITE_U16(buf, x) *(buf)     = (unsigned char)((x)&0xff);\
-                          *((buf)+1) = (unsigned char)(((x)>>8)&0xff);
-
-typedef struct WAV_HEADER {
-    unsigned char chunkId[4];
-    uint32_t chunkSize;
-    unsigned char format[4];
-    unsigned char subchunk1Id[4];
-    uint32_t subchunk1Size;
-    uint16_t audioFormat;
-    uint16_t numChannels;
-    uint32_t sampleRate;
-    uint32_t byteRate;
-    uint16_t blockAlign;
-    uint16_t bitsPerSample;
-    unsigned char subchunk2Id[4];
-    uint32_t subchunk2Size;
-} WavHeader;
-
-static int DecodeAudio(AVCodecContext* dec_ctx, AVFrame* frame, AVPacket* pkt, SwrContext* swr_ctx, FILE* outfile)
+// Everything about the output an export call can choose.
+typedef struct OUTPUT_SETTINGS {
+    OutputFormat format;
+    enum WavContainer container;
+    enum AudioCodec codec;
+    enum AudioContainer muxer;
+} OutputSettings;
+
+static void DefaultOutputSettings(OutputSettings* settings)
 {
-    int ret, data_size;
-    int dst_nb_samples = 0, dst_linesize;
-    uint8_t** dst_data = NULL;
-
-    ret = avcodec_send_packet(dec_ctx, pkt);
+    output_format_init(&settings->format);
+    settings->container = WAV_CONTAINER_AUTO;
+    settings->codec = AUDIO_CODEC_PCM;
+    settings->muxer = AUDIO_CONTAINER_DEFAULT;
+}
 
-    if (ret < 0) {
-        fprintf(stderr, "Error submitting the packet to the decoder %d \n", ret);
-        return ret;
+// Maps the public format description onto OutputSettings, starting from the
+// default so that zero fields keep it. A NULL format is the default.
+static int ToOutputSettings(const ConvertSoundFormat* format, OutputSettings* settings)
+{
+    OutputFormat* out = &settings->format;
+
+    DefaultOutputSettings(settings);
+    if (!format)
+        return 0;
+
+    switch (format->container) {
+    case CONVERT_SOUND_CONTAINER_AUTO: settings->container = WAV_CONTAINER_AUTO; break;
+    case CONVERT_SOUND_CONTAINER_WAV:  settings->container = WAV_CONTAINER_RIFF; break;
+    case CONVERT_SOUND_CONTAINER_RF64: settings->container = WAV_CONTAINER_RF64; break;
+    case CONVERT_SOUND_CONTAINER_W64:  settings->container = WAV_CONTAINER_W64; break;
+    case CONVERT_SOUND_CONTAINER_AU:   settings->muxer = AUDIO_CONTAINER_AU; break;
+    case CONVERT_SOUND_CONTAINER_CAF:  settings->muxer = AUDIO_CONTAINER_CAF; break;
+    case CONVERT_SOUND_CONTAINER_RAW:  settings->muxer = AUDIO_CONTAINER_RAW; break;
+    case CONVERT_SOUND_CONTAINER_MKV:  settings->muxer = AUDIO_CONTAINER_MKV; break;
+    default:
+        fprintf(stderr, "Unsupported output container %d\n", format->container);
+        return -1;
     }
 
-    while (ret >= 0) {
-        ret = avcodec_receive_frame(dec_ctx, frame);
-        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
-            return 0;
-        else if (ret < 0) {
-            fprintf(stderr, "Error duirng decoding \n");
-            return ret;
-        }
-        data_size = av_get_bytes_per_sample(dec_ctx->sample_fmt);
-        if (data_size < 0) {
-            fprintf(stderr, "Failed to calculate data size\n");
-            exit(1);
-        }
-
-        if (dst_nb_samples == 0) {
-            dst_nb_samples = av_rescale_rnd(frame->nb_samples, 8000, 8000, AV_ROUND_UP);
-            ret = av_samples_alloc_array_and_samples(&dst_data, &dst_linesize, 1, dst_nb_samples, AV_SAMPLE_FMT_S16, 0);
-            ret = av_samples_alloc(dst_data, &dst_linesize, 1, dst_nb_samples, AV_SAMPLE_FMT_S16, 1);
-        }
-        ret = swr_convert(swr_ctx, dst_data, dst_nb_samples, (const uint8_t**)frame->data, frame->nb_samples);        
+    if (format->sampleRate > 0)
+        out->sampleRate = format->sampleRate;
+    if (format->channels > 0)
+        out->channelLayout = av_get_default_channel_layout(format->channels);
 
-        int dst_bufsize = av_samples_get_buffer_size(&dst_linesize, 1, ret, AV_SAMPLE_FMT_S16, 1);
-        int size = fwrite(dst_data[0], 1, dst_bufsize, outfile);
-        return size;
+    int bits = format->bitsPerSample ? format->bitsPerSample : format->isFloat ? 32 : 16;
+    if (format->encoding == CONVERT_SOUND_ENCODING_MULAW || format->encoding == CONVERT_SOUND_ENCODING_ALAW) {
+        out->sampleFmt = !format->isFloat && (bits == 8 || !format->bitsPerSample) ? AV_SAMPLE_FMT_S16 : AV_SAMPLE_FMT_NONE;
+        out->law = format->encoding == CONVERT_SOUND_ENCODING_MULAW ? G711_ULAW : G711_ALAW;
+    }
+    else if (format->encoding < CONVERT_SOUND_ENCODING_PCM || format->encoding > CONVERT_SOUND_ENCODING_G726)
+        out->sampleFmt = AV_SAMPLE_FMT_NONE;
+    else if (format->isFloat && bits == 32)
+        out->sampleFmt = AV_SAMPLE_FMT_FLT;
+    else if (!format->isFloat && bits == 8)
+        out->sampleFmt = AV_SAMPLE_FMT_U8;
+    else if (!format->isFloat && bits == 16)
+        out->sampleFmt = AV_SAMPLE_FMT_S16;
+    else if (!format->isFloat && bits == 32)
+        out->sampleFmt = AV_SAMPLE_FMT_S32;
+    else
+        out->sampleFmt = AV_SAMPLE_FMT_NONE;
+
+    // The encodings after the G.711 laws follow enum AudioCodec in order.
+    if (format->encoding > CONVERT_SOUND_ENCODING_ALAW && out->sampleFmt != AV_SAMPLE_FMT_NONE) {
+        settings->codec = (enum AudioCodec)(format->encoding - CONVERT_SOUND_ENCODING_ALAW);
+        out->sampleFmt = audio_codec_sample_fmt(settings->codec, out->sampleFmt);
+        out->sampleRate = audio_codec_sample_rate(settings->codec, out->sampleRate);
+        if (format->container == CONVERT_SOUND_CONTAINER_WAV)
+            settings->muxer = AUDIO_CONTAINER_WAV;
     }
 
-    return 0;
-}
-
-static int WritePrelimHeader(FILE* outfile, unsigned char* headbuf)
-{
-    int bytespersec = 8000 * 16 / 8;
-    int align = 16 / 8;
-    int samplesize = 16;
-    unsigned int size = 0x7fffffff;
-
-    memcpy(headbuf, "RIFF", 4);
-    WRITE_U32(headbuf + 4, size - 8);
-    memcpy(headbuf + 8, "WAVE", 4);
-    memcpy(headbuf + 12, "fmt ", 4);
-    WRITE_U32(headbuf + 16, 16);
-    WRITE_U16(headbuf + 20, 1);  /* format */
-    WRITE_U16(headbuf + 22, 1);
-    WRITE_U32(headbuf + 24, 8000);
-    WRITE_U32(headbuf + 28, bytespersec);
-    WRITE_U16(headbuf + 32, align);
-    WRITE_U16(headbuf + 34, samplesize);
-    memcpy(headbuf + 36, "data", 4);
-    WRITE_U32(headbuf + 40, size - 44);
-
-    if (fwrite(headbuf, 1, 44, outfile) != 44)
-    {
-        fprintf(stderr, "ERROR: Failed to write wav header: \n");
+    if (format->sampleRate < 0 || format->channels < 0 || !out->channelLayout ||
+        out->sampleFmt == AV_SAMPLE_FMT_NONE) {
+        fprintf(stderr, "Unsupported output format\n");
         return -1;
     }
 
     return 0;
 }
 
-static int RewriteHeader(FILE* outfile, unsigned char* headbuf, unsigned int written)
+// The byte copy writes a canonical RIFF header, so it only stands in for the
+// containers that would produce one, and never for libavformat output.
+static int CopyIfMatching(char* inputname, char* outputname, const OutputSettings* settings)
 {
-    unsigned int length = written;
-
-    length += 44;
+    if (audio_encoder_needed(settings->codec, settings->muxer) ||
+        (settings->container != WAV_CONTAINER_AUTO && settings->container != WAV_CONTAINER_RIFF))
+        return 0;
 
-    WRITE_U32(headbuf + 4, length - 8);
-    WRITE_U32(headbuf + 40, length - 44);
-    if (fseek(outfile, 0, SEEK_SET) != 0)
-    {
-        fprintf(stderr, "ERROR: Failed to seek on seekable file: \n");
-        return 1;
-    }
-
-    if (fwrite(headbuf, 1, 44, outfile) != 44)
-    {
-        fprintf(stderr, "ERROR: Failed to write wav header: \n");
-        return 1;
-    }
-    return 0;
+    int64_t copied;
+    return wav_copy_file(inputname, outputname, &settings->format, &copied);
 }
 
-EXPORT int ResampleWave(char* inputname, char* outputname)
+static int ResampleWaveFile(char* inputname, char* outputname, const OutputSettings* settings)
 {
-    WavHeader wavHeader;
-    int headerSize = sizeof(WavHeader);
+    const OutputFormat* out = &settings->format;
+    WavFormat wavFormat;
+
+    int copy = CopyIfMatching(inputname, outputname, settings);
+    if (copy != 0)
+        return copy < 0 ? -1 : 1;
 
     FILE* wavFile;
-    fopen_s(&wavFile, inputname, "r");
+    fopen_s(&wavFile, inputname, "rb");
     if (wavFile == nullptr)
     {
         fprintf(stderr, "Unable to open wave file: %s\n", inputname);
         return -1;
     }
 
-    fread(&wavHeader, 1, headerSize, wavFile);
-    fseek(wavFile, headerSize, SEEK_SET);
+    if (wav_read_format(wavFile, &wavFormat) < 0) {
+        fprintf(stderr, "Could not read wave format from %s\n", inputname);
+        fclose(wavFile);
+        return -1;
+    }
+
+    FileWriter writer;
 
-    uint8_t* wav_data = (uint8_t*)malloc(sizeof(uint8_t) * wavHeader.subchunk2Size);
-    fread(wav_data, sizeof(uint8_t), wavHeader.subchunk2Size, wavFile); //read in our whole sound data chunk
+    if (file_writer_open(&writer, outputname, 0) < 0) {
+        fprintf(stderr, "Could not open destination file %s\n", outputname);
+        fclose(wavFile);
+        return -1;
+    }
+    int64_t expected = output_format_data_size(out, wav_duration(&wavFormat));
+    WavHeader header;
+    wav_header_init(&header, out, settings->container, expected);
+
+    OutputSink sink;
+    OutputSink* pcm_sink = &sink;
+    AudioEncoder* encoder = NULL;
+    int64_t ret = 0;
+    output_sink_init_writer(&sink, &writer);
+
+    if (audio_encoder_needed(settings->codec, settings->muxer)) {
+        ret = audio_encoder_open(&encoder, settings->codec, settings->muxer, out, &sink, 1);
+        if (ret >= 0)
+            pcm_sink = audio_encoder_input(encoder);
+    }
+    else {
+        file_writer_preallocate(&writer, expected + header.size);
+        wav_header_write(&header, &sink, WAV_HEADER_UNKNOWN_SIZE);
+    }
 
+    if (ret >= 0 && wavFormat.dataSize >= RESAMPLE_MMAP_THRESHOLD)
+        ret = resample_wave_mapped(wavFile, &wavFormat, out, pcm_sink, RESAMPLE_BLOCK_FRAMES);
+    else if (ret >= 0)
+        ret = resample_wave_stream(wavFile, &wavFormat, out, pcm_sink, RESAMPLE_BLOCK_FRAMES);
+    if (ret >= 0 && encoder)
+        ret = audio_encoder_finish(encoder);
+    else if (ret >= 0)
+        ret = wav_header_finalize(&header, &sink, (uint64_t)ret) == 0 ? ret : -1;
+
+    audio_encoder_free(&encoder);
+    if (file_writer_close(&writer) < 0)
+        ret = -1;
     fclose(wavFile);
 
-    uint8_t** src_data = NULL, ** dst_data = NULL;
-    int src_rate = wavHeader.sampleRate, dst_rate = 8000;
-    int src_nb_channels = wavHeader.numChannels, dst_nb_channels = 0;
-    int src_linesize, dst_linesize;
-    int64_t src_ch_layout = av_get_default_channel_layout(src_nb_channels), dst_ch_layout = AV_CH_LAYOUT_MONO;
-    enum AVSampleFormat src_sample_fmt = AV_SAMPLE_FMT_S16, dst_sample_fmt = AV_SAMPLE_FMT_S16;
-    int src_nb_samples, dst_nb_samples;
-    static struct SwrContext* swr_ctx;
-    int dst_bufsize;
+    return ret < 0 ? -1 : 1;
+}
+
+EXPORT int ResampleWave(char* inputname, char* outputname)
+{
+    return ResampleWaveEx(inputname, outputname, NULL);
+}
+
+EXPORT int ResampleWaveEx(char* inputname, char* outputname, const ConvertSoundFormat* format)
+{
+    OutputSettings settings;
+    if (ToOutputSettings(format, &settings) < 0)
+        return -1;
+
+    return ResampleWaveFile(inputname, outputname, &settings);
+}
+
+static int ConvertInput(AVFormatContext* format, const char* inputname, const InputOptions* input, const OutputSettings* settings, OutputSink* sink)
+{
     int ret;
+    AVPacket* pkt;
+    DecodeSession* session = NULL;
+    OutputSettings default_settings;
 
-    FILE* dstFile;
+    if (!settings) {
+        DefaultOutputSettings(&default_settings);
+        settings = &default_settings;
+    }
+    const OutputFormat* out = &settings->format;
 
-    fopen_s(&dstFile, outputname, "wb");
+    int stream_index = input_find_audio_stream(format, inputname, input);
+    if (stream_index < 0)
+        return -1;
 
-    if (!dstFile) {
-        fprintf(stderr, "Could not open destination file %s\n", outputname);
+    AVStream* audio_stream = format->streams[stream_index];
+    AVCodecParameters* params = audio_stream->codecpar;
+
+    if (decode_session_open(&session, params, out, 1) < 0)
         return -1;
+
+    av_dump_format(format, 0, inputname, 0);
+
+    pkt = av_packet_alloc();
+
+    // Every sink here takes positioned writes, so the muxer may patch its header.
+    WavHeader header;
+    AudioEncoder* encoder = NULL;
+    OutputSink* pcm_sink = sink;
+    if (audio_encoder_needed(settings->codec, settings->muxer)) {
+        if (audio_encoder_open(&encoder, settings->codec, settings->muxer, out, sink, 1) < 0) {
+            decode_session_free(&session);
+            av_packet_free(&pkt);
+            return -1;
+        }
+        pcm_sink = audio_encoder_input(encoder);
+    }
+    else {
+        wav_header_init(&header, out, settings->container, output_format_data_size(out, format->duration));
+        wav_header_write(&header, sink, WAV_HEADER_UNKNOWN_SIZE);
     }
+    uint64_t sound_length = 0;
+
+    // A corrupt packet is skipped, a failed write ends the conversion.
+    while (!pcm_sink->failed && av_read_frame(format, pkt) >= 0) {
+        if (pkt->stream_index == stream_index) {
+            ret = decode_session_send_packet(session, pkt, pcm_sink);
+            if (ret > 0)
+            {
+                sound_length += ret;
+            }
+        }
 
-    uint16_t bytesPerSample = wavHeader.bitsPerSample / 8;
-    src_nb_samples = wavHeader.subchunk2Size / bytesPerSample;
-    src_ch_layout = av_get_default_channel_layout(src_nb_channels);
+        av_packet_unref(pkt);
+    }
 
-    swr_ctx = swr_alloc();
-    if (!swr_ctx) {
-        fprintf(stderr, "Could not allocate resampler context\n");
-        ret = AVERROR(ENOMEM);
-        return -1;
+    if (!pcm_sink->failed) {
+        ret = decode_session_flush(session, pcm_sink);
+        if (ret > 0)
+        {
+            sound_length += ret;
+        }
     }
 
-    av_opt_set_int(swr_ctx, "in_channel_layout", src_ch_layout, 0);
-    av_opt_set_int(swr_ctx, "in_sample_rate", src_rate, 0);
-    av_opt_set_sample_fmt(swr_ctx, "in_sample_fmt", src_sample_fmt, 0);
+    if (pcm_sink->failed)
+        ret = -1;
+    else if (encoder)
+        ret = audio_encoder_finish(encoder) == 0 ? 1 : -1;
+    else
+        ret = wav_header_finalize(&header, sink, sound_length) == 0 ? 1 : -1;
 
-    av_opt_set_int(swr_ctx, "out_channel_layout", dst_ch_layout, 0);
-    av_opt_set_int(swr_ctx, "out_sample_rate", dst_rate, 0);
-    av_opt_set_sample_fmt(swr_ctx, "out_sample_fmt", dst_sample_fmt, 0);
-    swr_init(swr_ctx);
+    audio_encoder_free(&encoder);
+    decode_session_free(&session);
+    av_packet_free(&pkt);
 
-    unsigned char headbuf[44];
-    WritePrelimHeader(dstFile, headbuf);
-    unsigned int sound_length = 0;
+    return ret;
+}
 
-    ret = av_samples_alloc_array_and_samples(&src_data, &src_linesize, src_nb_channels, src_nb_samples, src_sample_fmt, 0);
-    if (ret < 0) {
-        fprintf(stderr, "Could not allocate source samples\n");
+static int ConvertInputToFile(AVFormatContext* format, const char* inputname, const InputOptions* input, const OutputSettings* settings, char* outputname)
+{
+    FileWriter writer;
+    OutputSettings default_settings;
+
+    if (!settings) {
+        DefaultOutputSettings(&default_settings);
+        settings = &default_settings;
+    }
+
+    if (file_writer_open(&writer, outputname, 0) < 0) {
+        fprintf(stderr, "Could not open destination file %s\n", outputname);
         return -1;
     }
 
-    src_data[0] = wav_data;
+    // Known durations let the file be reserved in one piece up front.
+    int64_t expected = output_format_data_size(&settings->format, format->duration);
+    if (expected > 0 && !audio_encoder_needed(settings->codec, settings->muxer))
+        file_writer_preallocate(&writer, expected + WAV_HEADER_MAX_SIZE);
+
+    OutputSink sink;
+    output_sink_init_writer(&sink, &writer);
+    int ret = ConvertInput(format, inputname, input, settings, &sink);
+
+    if (file_writer_close(&writer) < 0)
+        ret = -1;
+
+    return ret;
+}
+
+static int ConvertInputToBuffer(AVFormatContext* format, const char* inputname, uint8_t** outdata, size_t* outsize, size_t capacity)
+{
+    OutputSink sink;
+    output_sink_init_buffer(&sink, *outdata, capacity);
 
-    dst_nb_channels = av_get_channel_layout_nb_channels(dst_ch_layout);
-    dst_nb_samples = av_rescale_rnd(swr_get_delay(swr_ctx, src_rate) + src_nb_samples, dst_rate, src_rate, AV_ROUND_UP);
+    int ret = ConvertInput(format, inputname, NULL, NULL, &sink);
+    *outsize = sink.size;
 
-    ret = av_samples_alloc_array_and_samples(&dst_data, &dst_linesize, dst_nb_channels, dst_nb_samples, dst_sample_fmt, 0);
-    if (ret < 0) {
-        fprintf(stderr, "Could not allocate destinate samples\n");
+    if (output_sink_overflowed(&sink)) {
+        fprintf(stderr, "Output buffer too small, %zu bytes needed\n", sink.size);
         return -1;
     }
+    if (sink.growable) {
+        if (ret < 0)
+            av_freep(&sink.data);
+        *outdata = sink.data;
+    }
 
-    ret = swr_convert(swr_ctx, dst_data, dst_nb_samples, (const uint8_t**)src_data, src_nb_samples);
-    if (ret < 0) {
-        fprintf(stderr, "Error while converting\n");
+    return ret;
+}
+
+static int OpenInputFile(AVFormatContext** format, const char* inputname, const InputOptions* input)
+{
+    return input_open_file(format, inputname, input) < 0 ? -1 : 0;
+}
+
+static int OpenInputBuffer(AVFormatContext** format, const uint8_t* data, size_t size)
+{
+    if (!data || size == 0) {
+        fprintf(stderr, "Input buffer is empty\n");
         return -1;
     }
 
-    dst_bufsize = av_samples_get_buffer_size(&dst_linesize, dst_nb_channels, ret, dst_sample_fmt, 1);
-    if (dst_bufsize < 0) {
-        fprintf(stderr, "Could not get sample buffer size\n");
+    if (avio_input_open_buffer(format, data, size) < 0) {
+        fprintf(stderr, "Could not open input buffer\n");
         return -1;
     }
 
-    sound_length += fwrite(dst_data[0], 1, dst_bufsize, dstFile);
+    return 0;
+}
 
-    RewriteHeader(dstFile, headbuf, sound_length);
+EXPORT int ConvertSound(char* inputname, char* outputname)
+{
+    return ConvertSoundEx(inputname, outputname, NULL);
+}
 
-    fclose(dstFile);
+// File conversion shared by ConvertSoundEx() and ConvertSoundFast().
+static int ConvertFile(char* inputname, char* outputname, const ConvertSoundFormat* outformat, const InputOptions* input)
+{
+    AVFormatContext* format = NULL;
+    OutputSettings settings;
 
-    if (src_data)
-        av_freep(&src_data);
+    if (ToOutputSettings(outformat, &settings) < 0)
+        return -1;
 
-    if (dst_data)
-        av_freep(&dst_data);
+    int copy = CopyIfMatching(inputname, outputname, &settings);
+    if (copy != 0)
+        return copy < 0 ? -1 : 1;
 
-    swr_free(&swr_ctx);
+    if (OpenInputFile(&format, inputname, input) < 0)
+        return -1;
 
-    return 1;
+    int ret = ConvertInputToFile(format, inputname, input, &settings, outputname);
+    avformat_close_input(&format);
+
+    return ret;
 }
 
-EXPORT int ConvertSound(char* inputname, char* outputname)
+EXPORT int ConvertSoundEx(char* inputname, char* outputname, const ConvertSoundFormat* outformat)
 {
-    const AVCodec* codec;
-    AVCodecContext* c = NULL;
-    int ret;
-    FILE* infile, * outfile;
-    uint8_t inbuf[AUDIO_INBUF_SIZE + AV_INPUT_BUFFER_PADDING_SIZE];
-    AVPacket* pkt;
-    AVFrame* decoded_frame = NULL;
-    static struct SwrContext* swr_ctx;
+    return ConvertFile(inputname, outputname, outformat, NULL);
+}
 
-    pkt = av_packet_alloc();
+EXPORT int ConvertSoundFast(char* inputname, char* outputname, const ConvertSoundFormat* outformat, const char* formatHint)
+{
+    InputOptions input;
+    input_options_init(&input);
+    input.fast = 1;
+    input.formatHint = formatHint;
 
-    AVFormatContext* format = avformat_alloc_context();
+    return ConvertFile(inputname, outputname, outformat, &input);
+}
 
-    int res = avformat_open_input(&format, inputname, NULL, NULL);
-    if (res != 0) {
-        fprintf(stderr, "Could not open file '%s'\n", inputname);
-        return -1;
-    }
-    if (avformat_find_stream_info(format, NULL) < 0) {
-        fprintf(stderr, "Could not retrieve stream info from file '%s'\n", inputname);
-        return -1;
-    }
+EXPORT int ConvertSoundFromBuffer(const uint8_t* data, size_t size, char* outputname)
+{
+    AVFormatContext* format = NULL;
 
-    int stream_index = -1;
-    for (int i = 0; i < format->nb_streams; i++) {
-        if (format->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
-            stream_index = i;
-            break;
-        }
-    }
-    if (stream_index == -1) {
-        fprintf(stderr, "Could not retrieve audio stream from file '%s'\n", inputname);
+    if (OpenInputBuffer(&format, data, size) < 0)
         return -1;
-    }
 
-    AVStream* audio_stream = format->streams[stream_index];
-    AVCodecParameters* params = audio_stream->codecpar;
+    int ret = ConvertInputToFile(format, "memory", NULL, NULL, outputname);
+    avio_input_close(&format);
 
-    codec = avcodec_find_decoder(params->codec_id);
-    if (!codec) {
-        fprintf(stderr, "Codec not found\n");
-        return -1;
-    }
+    return ret;
+}
 
-    c = avcodec_alloc_context3(codec);
-    if (!c) {
-        fprintf(stderr, "Could not allocate audio codec context\n");
-        return -1;
-    }
+EXPORT int ConvertSoundFromCallbacks(ConvertSoundReadFunc read, ConvertSoundSeekFunc seek, void* opaque, char* outputname)
+{
+    AVFormatContext* format = NULL;
 
-    if (avcodec_open2(c, codec, NULL) < 0) {
-        fprintf(stderr, "Could not open codec\n");
+    if (avio_input_open_callbacks(&format, read, seek, opaque) < 0) {
+        fprintf(stderr, "Could not open callback input\n");
         return -1;
     }
 
-    swr_ctx = swr_alloc();
+    int ret = ConvertInputToFile(format, "callback", NULL, NULL, outputname);
+    avio_input_close(&format);
+
+    return ret;
+}
+
+EXPORT int ConvertSoundToBuffer(char* inputname, uint8_t** outdata, size_t* outsize, size_t capacity)
+{
+    AVFormatContext* format = NULL;
 
-    if (!swr_ctx) {
-        fprintf(stderr, "Could not allocate resampler context\n");
+    if (OpenInputFile(&format, inputname, NULL) < 0)
         return -1;
-    }
 
-    av_opt_set_int(swr_ctx, "in_channel_layout", params->channel_layout, 0);
-    av_opt_set_int(swr_ctx, "in_sample_rate", params->sample_rate, 0);
-    av_opt_set_sample_fmt(swr_ctx, "in_sample_fmt", static_cast<AVSampleFormat>(params->format), 0);
+    int ret = ConvertInputToBuffer(format, inputname, outdata, outsize, capacity);
+    avformat_close_input(&format);
 
-    av_opt_set_int(swr_ctx, "out_channel_layout", AV_CH_LAYOUT_MONO, 0);
-    av_opt_set_int(swr_ctx, "out_sample_rate", 8000, 0);
-    av_opt_set_sample_fmt(swr_ctx, "out_sample_fmt", AV_SAMPLE_FMT_S16, 0);
-    swr_init(swr_ctx);
+    return ret;
+}
 
-    av_dump_format(format, 0, inputname, 0);
+EXPORT int ConvertSoundBufferToBuffer(const uint8_t* data, size_t size, uint8_t** outdata, size_t* outsize, size_t capacity)
+{
+    AVFormatContext* format = NULL;
 
-    decoded_frame = av_frame_alloc();
-    if (decoded_frame == NULL) {
-        fprintf(stderr, "Could not allocate frame\n");
-        ret = AVERROR(ENOMEM);
+    if (OpenInputBuffer(&format, data, size) < 0)
         return -1;
-    }
 
-    av_init_packet(pkt);
-    pkt->data = inbuf;
-    pkt->size = AUDIO_INBUF_SIZE + AV_INPUT_BUFFER_PADDING_SIZE;
-    pkt->stream_index = stream_index;
+    int ret = ConvertInputToBuffer(format, "memory", outdata, outsize, capacity);
+    avio_input_close(&format);
 
-    int pkt_i = 0;
+    return ret;
+}
+
+EXPORT int ConvertSoundToCallback(char* inputname, ConvertSoundWriteFunc write, void* opaque)
+{
+    AVFormatContext* format = NULL;
 
-    fopen_s(&infile, inputname, "rb");
-    if (!infile) {
-        fprintf(stderr, "Could not open %s\n", inputname);
+    if (!write || OpenInputFile(&format, inputname, NULL) < 0)
         return -1;
-    }
 
-    fopen_s(&outfile, outputname, "wb");
-    if (!outfile) {
-        av_free(c);
+    OutputSink sink;
+    output_sink_init_callback(&sink, write, opaque);
+
+    int ret = ConvertInput(format, inputname, NULL, NULL, &sink);
+    avformat_close_input(&format);
+
+    return ret;
+}
+
+EXPORT int ConvertSoundBufferToCallback(const uint8_t* data, size_t size, ConvertSoundWriteFunc write, void* opaque)
+{
+    AVFormatContext* format = NULL;
+
+    if (!write || OpenInputBuffer(&format, data, size) < 0)
         return -1;
-    }
 
-    unsigned char headbuf[44];
-    WritePrelimHeader(outfile, headbuf);
-    unsigned int sound_length = 0;
+    OutputSink sink;
+    output_sink_init_callback(&sink, write, opaque);
 
-    while (av_read_frame(format, pkt) >= 0) {
-        if (pkt->stream_index == stream_index) {
-            ret = DecodeAudio(c, decoded_frame, pkt, swr_ctx, outfile);
-            if (ret > 0)
-            {
-                sound_length += ret;
-            }
-        }
-        pkt_i++;
+    int ret = ConvertInput(format, "memory", NULL, NULL, &sink);
+    avio_input_close(&format);
 
-        av_packet_unref(pkt);
+    return ret;
+}
+
+EXPORT void ConvertSoundFree(uint8_t* data)
+{
+    av_free(data);
+}
+
+static int ConvertBatchJob(void* opaque, const char* input, const char* output, double* audio_seconds)
+{
+    *audio_seconds = 0;
+    return ConvertSoundEx((char*)input, (char*)output, (const ConvertSoundFormat*)opaque);
+}
+
+EXPORT int ConvertSoundBatch(ConvertSoundJob* jobs, int count, int threads)
+{
+    if (!jobs || count <= 0)
+        return 0;
+
+    BatchJob* batch = (BatchJob*)av_calloc(count, sizeof(BatchJob));
+    if (!batch)
+        return 0;
+
+    for (int i = 0; i < count; i++) {
+        batch[i].input = jobs[i].inputname;
+        batch[i].output = jobs[i].outputname;
     }
 
-    RewriteHeader(outfile, headbuf, sound_length);
+    batch_run(batch, count, threads, ConvertBatchJob, NULL, NULL);
 
-    fclose(infile);
-    fclose(outfile);    
-    avcodec_free_context(&c);
-    av_frame_free(&decoded_frame);
-    av_packet_free(&pkt);
-    avformat_close_input(&format);
+    int succeeded = 0;
+    for (int i = 0; i < count; i++) {
+        jobs[i].result = batch[i].result < 0 ? -1 : 1;
+        if (batch[i].result >= 0)
+            succeeded++;
+    }
 
-    return 1;
-}
\ No newline at end of file
+    av_free(batch);
+
+    return succeeded;
+}
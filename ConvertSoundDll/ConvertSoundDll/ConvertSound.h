@@ -0,0 +1,123 @@
+// ConvertSound.h : Functions exported by ConvertSound.dll.
+//
+// Every export keeps its buffers local to the call, so any number of threads may
+// call them at the same time without a lock. Decoders and resampler contexts are
+// taken from and returned to shared, internally locked pools, so calls with the
+// same codec or the same input and output format skip opening the decoder or
+// rebuilding the filter bank.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef EXPORT
+#ifdef _WIN32
+#define EXPORT extern "C" __declspec(dllimport)
+#else
+#define EXPORT extern "C"
+#endif
+#endif
+
+// Input callbacks, same contract as FFmpeg's avio_alloc_context(): read returns the
+// number of bytes copied into buf (0 or a negative value ends the input), seek
+// takes SEEK_SET/SEEK_CUR/SEEK_END and returns the new position, or the total
+// size when whence is 0x10000 (AVSEEK_SIZE). Return a negative value when unsupported.
+typedef int (*ConvertSoundReadFunc)(void* opaque, uint8_t* buf, int buf_size);
+typedef int64_t (*ConvertSoundSeekFunc)(void* opaque, int64_t offset, int whence);
+
+// Output callback: buf belongs at offset in the WAV result. Audio data arrives in
+// order; once it is complete the header is sent again at offset 0 with the final
+// sizes, same length as the first time. Compressed encodings may instead patch
+// other bytes already written, such as the FLAC STREAMINFO block. Return size
+// on success, anything else aborts the conversion.
+typedef int (*ConvertSoundWriteFunc)(void* opaque, int64_t offset, const uint8_t* buf, int size);
+
+typedef struct CONVERT_SOUND_JOB {
+    const char* inputname;
+    const char* outputname;
+    int result;                 // set by ConvertSoundBatch(), 1 on success and -1 on failure
+} ConvertSoundJob;
+
+// File layout of the result. AUTO writes a canonical 44-byte RIFF header when
+// the input duration is known and small, and otherwise reserves room to turn
+// the header into RF64 in place if the data passes 4 GB.
+#define CONVERT_SOUND_CONTAINER_AUTO 0
+#define CONVERT_SOUND_CONTAINER_WAV 1
+#define CONVERT_SOUND_CONTAINER_RF64 2
+#define CONVERT_SOUND_CONTAINER_W64 3
+
+// Written through the FFmpeg muxers rather than the built-in WAV writer: Sun
+// AU (big-endian samples), Core Audio CAF, headerless samples (s16le and the
+// like, or the bare FLAC, G.722 or G.726 stream) and Matroska audio.
+#define CONVERT_SOUND_CONTAINER_AU 4
+#define CONVERT_SOUND_CONTAINER_CAF 5
+#define CONVERT_SOUND_CONTAINER_RAW 6
+#define CONVERT_SOUND_CONTAINER_MKV 7
+
+// Sample coding. The G.711 laws store 8 bits per sample (WAVE_FORMAT_MULAW and
+// WAVE_FORMAT_ALAW), ready for telephony playout as they are.
+#define CONVERT_SOUND_ENCODING_PCM 0
+#define CONVERT_SOUND_ENCODING_MULAW 1
+#define CONVERT_SOUND_ENCODING_ALAW 2
+
+// Compressed output through the FFmpeg encoders. In an AUTO container FLAC is
+// written as a .flac stream and the others in WAV; RF64 and W64 do not apply. FLAC takes 16
+// or 32 bits per sample (stored as 24), the rest 16. IMA and MS ADPCM are mono
+// or stereo, G.722 (always 16000 Hz, sampleRate is ignored) and G.726
+// (32 kbit/s, 8000 Hz only) mono.
+#define CONVERT_SOUND_ENCODING_FLAC 3
+#define CONVERT_SOUND_ENCODING_ADPCM_IMA 4
+#define CONVERT_SOUND_ENCODING_ADPCM_MS 5
+#define CONVERT_SOUND_ENCODING_G722 6
+#define CONVERT_SOUND_ENCODING_G726 7
+
+// Output format for the *Ex functions. Zero fields keep the default of 8000 Hz
+// mono 16-bit PCM in an AUTO container. bitsPerSample is 8, 16 or 32, or 32
+// with isFloat set; with a G.711 encoding it is 0 or 8. Input that already has
+// the requested format is copied without resampling.
+typedef struct CONVERT_SOUND_FORMAT {
+    int sampleRate;
+    int channels;
+    int bitsPerSample;
+    int isFloat;
+    int container;              // CONVERT_SOUND_CONTAINER_*
+    int encoding;               // CONVERT_SOUND_ENCODING_*
+} ConvertSoundFormat;
+
+EXPORT int ResampleWave(char* inputname, char* outputname);
+EXPORT int ConvertSound(char* inputname, char* outputname);
+
+// Same as ResampleWave() and ConvertSound() writing format, which may be NULL.
+EXPORT int ResampleWaveEx(char* inputname, char* outputname, const ConvertSoundFormat* format);
+EXPORT int ConvertSoundEx(char* inputname, char* outputname, const ConvertSoundFormat* format);
+
+// ConvertSoundEx() with bounded probing: reads at most 32 KB / 0.5 s to find the
+// streams and skips the stream info pass when the container header already
+// describes the audio. formatHint names the demuxer ("mp3", "mov", "wav", ...);
+// NULL infers it from the first bytes and the extension.
+EXPORT int ConvertSoundFast(char* inputname, char* outputname, const ConvertSoundFormat* format, const char* formatHint);
+
+// Converts size bytes of an encoded file held in memory.
+EXPORT int ConvertSoundFromBuffer(const uint8_t* data, size_t size, char* outputname);
+
+// Converts input pulled through read/seek. seek may be NULL for non-seekable sources.
+EXPORT int ConvertSoundFromCallbacks(ConvertSoundReadFunc read, ConvertSoundSeekFunc seek, void* opaque, char* outputname);
+
+// Writes the WAV result to memory. If *outdata is NULL the library allocates a
+// buffer that the caller releases with ConvertSoundFree(); otherwise *outdata is a
+// caller buffer of capacity bytes. *outsize receives the result size, or on a too
+// small caller buffer the size that would have been needed (the call then fails).
+EXPORT int ConvertSoundToBuffer(char* inputname, uint8_t** outdata, size_t* outsize, size_t capacity);
+EXPORT int ConvertSoundBufferToBuffer(const uint8_t* data, size_t size, uint8_t** outdata, size_t* outsize, size_t capacity);
+
+// Streams the WAV result through write.
+EXPORT int ConvertSoundToCallback(char* inputname, ConvertSoundWriteFunc write, void* opaque);
+EXPORT int ConvertSoundBufferToCallback(const uint8_t* data, size_t size, ConvertSoundWriteFunc write, void* opaque);
+
+EXPORT void ConvertSoundFree(uint8_t* data);
+
+// Converts count files on up to threads worker threads (0 uses every core),
+// largest inputs first. Returns the number of jobs that succeeded.
+EXPORT int ConvertSoundBatch(ConvertSoundJob* jobs, int count, int threads);
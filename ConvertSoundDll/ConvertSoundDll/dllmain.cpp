@@ -1,6 +1,9 @@
 // dllmain.cpp : Defines the entry point for the DLL application.
 #include "pch.h"
 
+#include "decoder_pool.h"
+#include "swr_pool.h"
+
 BOOL APIENTRY DllMain( HMODULE hModule,
                        DWORD  ul_reason_for_call,
                        LPVOID lpReserved
@@ -11,7 +14,14 @@ BOOL APIENTRY DllMain( HMODULE hModule,
     case DLL_PROCESS_ATTACH:
     case DLL_THREAD_ATTACH:
     case DLL_THREAD_DETACH:
+        break;
     case DLL_PROCESS_DETACH:
+        // On process exit (lpReserved set) other threads are already gone and
+        // the memory goes with the process anyway.
+        if (!lpReserved) {
+            decoder_pool_clear();
+            swr_pool_clear();
+        }
         break;
     }
     return TRUE;
@@ -1,7 +1,12 @@
 #pragma once
 
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN             // Exclude rarely-used stuff from Windows headers
 // Windows Header Files
 #include <windows.h>
 
 #define EXPORT extern "C" __declspec(dllexport)
+#else
+// libconvertsound.so is built with hidden visibility, only the exports show.
+#define EXPORT extern "C" __attribute__((visibility("default")))
+#endif
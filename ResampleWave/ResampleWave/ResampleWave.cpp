@@ -9,215 +9,198 @@
 extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
-#include <libavfilter/buffersink.h>
-#include <libavfilter/buffersrc.h>
 #include <libavutil/channel_layout.h>
 #include <libavutil/opt.h>
 #include <libavutil/pixdesc.h>
+#include <libavutil/time.h>
 #include <libswresample/swresample.h>
 }
 
-#define AUDIO_INBUF_SIZE 20480
-#define WRITE_U32(buf, x) *(buf)     = (unsigned char)((x)&0xff);\
-                          *((buf)+1) = (unsigned char)(((x)>>8)&0xff);\
-                          *((buf)+2) = (unsigned char)(((x)>>16)&0xff);\
-                          *((buf)+3) = (unsigned char)(((x)>>24)&0xff);
-#define WRITE_U16(buf, x) *(buf)     = (unsigned char)((x)&0xff);\
-                          *((buf)+1) = (unsigned char)(((x)>>8)&0xff);
-
-typedef struct WAV_HEADER {
-    unsigned char chunkId[4];
-    uint32_t chunkSize;
-    unsigned char format[4];
-    unsigned char subchunk1Id[4];
-    uint32_t subchunk1Size;
-    uint16_t audioFormat;
-    uint16_t numChannels;
-    uint32_t sampleRate;
-    uint32_t byteRate;
-    uint16_t blockAlign;
-    uint16_t bitsPerSample;
-    unsigned char subchunk2Id[4];
-    uint32_t subchunk2Size;
-} WavHeader;
-
-static int write_prelim_header(FILE* outfile, unsigned char* headbuf)
-{
-    int bytespersec = 8000 * 16 / 8;
-    int align = 16 / 8;
-    int samplesize = 16;
-    unsigned int size = 0x7fffffff;
-
-    memcpy(headbuf, "RIFF", 4);
-    WRITE_U32(headbuf + 4, size - 8);
-    memcpy(headbuf + 8, "WAVE", 4);
-    memcpy(headbuf + 12, "fmt ", 4);
-    WRITE_U32(headbuf + 16, 16);
-    WRITE_U16(headbuf + 20, 1);  /* format */
-    WRITE_U16(headbuf + 22, 1);
-    WRITE_U32(headbuf + 24, 8000);
-    WRITE_U32(headbuf + 28, bytespersec);
-    WRITE_U16(headbuf + 32, align);
-    WRITE_U16(headbuf + 34, samplesize);
-    memcpy(headbuf + 36, "data", 4);
-    WRITE_U32(headbuf + 40, size - 44);
-
-    if (fwrite(headbuf, 1, 44, outfile) != 44)
-    {
-        fprintf(stderr, "ERROR: Failed to write wav header: \n");
-        return -1;
-    }
-
-    return 0;
-}
+#include "compat.h"
+#include "resampler.h"
+#include "wav_copy.h"
+#include "wav_header.h"
+#include "wave_resample.h"
 
-static int rewrite_header(FILE* outfile, unsigned char* headbuf, unsigned int written)
-{
-    unsigned int length = written;
-
-    length += 44;
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
 
-    WRITE_U32(headbuf + 4, length - 8);
-    WRITE_U32(headbuf + 40, length - 44);
-    if (fseek(outfile, 0, SEEK_SET) != 0)
-    {
-        fprintf(stderr, "ERROR: Failed to seek on seekable file: \n");
-        return 1;
-    }
+#define AUDIO_INBUF_SIZE 20480
 
-    if (fwrite(headbuf, 1, 44, outfile) != 44)
-    {
-        fprintf(stderr, "ERROR: Failed to write wav header: \n");
-        return 1;
-    }
-    return 0;
-}
+enum InputMode {
+    INPUT_AUTO,
+    INPUT_FREAD,
+    INPUT_MMAP,
+};
 
-static int resample_wave(const char* filename)
+static int resample_wave(const char* filename, const OutputFormat* out, enum WavContainer container, int block_frames, InputMode mode, int threads, int writer_flags)
 {
-    WavHeader wavHeader;
-    int headerSize = sizeof(WavHeader);
+    WavFormat wavFormat;
+    const char* dst_filename = "result.wav";
+
+    // The copy writes a canonical RIFF header.
+    int64_t copied;
+    int copy = container == WAV_CONTAINER_AUTO || container == WAV_CONTAINER_RIFF ?
+               wav_copy_file(filename, dst_filename, out, &copied) : 0;
+    if (copy != 0)
+        return copy < 0 ? -1 : 0;
 
     FILE* wavFile;
-    fopen_s(&wavFile, filename, "r");
+    fopen_s(&wavFile, filename, "rb");
     if (wavFile == nullptr)
     {
         fprintf(stderr, "Unable to open wave file: %s\n", filename);
         return -1;
     }
 
-    fread(&wavHeader, 1, headerSize, wavFile);
-    fseek(wavFile, headerSize, SEEK_SET);
-
-    uint8_t* wav_data = (uint8_t*)malloc(sizeof(uint8_t) * wavHeader.subchunk2Size);
-    fread(wav_data, sizeof(uint8_t), wavHeader.subchunk2Size, wavFile); //read in our whole sound data chunk
-
-    fclose(wavFile);
-
-    uint8_t **src_data = NULL, **dst_data = NULL;
-    int src_rate = wavHeader.sampleRate, dst_rate = 8000;
-    int src_nb_channels = wavHeader.numChannels, dst_nb_channels = 0;
-    int src_linesize, dst_linesize;
-    int64_t src_ch_layout = av_get_default_channel_layout(src_nb_channels), dst_ch_layout = AV_CH_LAYOUT_MONO;
-    enum AVSampleFormat src_sample_fmt = AV_SAMPLE_FMT_S16, dst_sample_fmt = AV_SAMPLE_FMT_S16;
-    int src_nb_samples, dst_nb_samples;
-    static struct SwrContext* swr_ctx;
-    int dst_bufsize;
-    int ret;
-
-    const char* dst_filename = "result.wav";
-    FILE* dstFile;
-
-    fopen_s(&dstFile, dst_filename, "wb");
-
-    if (!dstFile) {
-        fprintf(stderr, "Could not open destination file %s\n", dst_filename);
-        return -1;
-    }
-
-    uint16_t bytesPerSample = wavHeader.bitsPerSample / 8;
-    src_nb_samples = wavHeader.subchunk2Size / bytesPerSample;
-    src_ch_layout = av_get_default_channel_layout(src_nb_channels);
-
-    swr_ctx = swr_alloc();
-    if (!swr_ctx) {
-        fprintf(stderr, "Could not allocate resampler context\n");
-        ret = AVERROR(ENOMEM);
-        return -1;
-    }
-
-    av_opt_set_int(swr_ctx, "in_channel_layout", src_ch_layout, 0);
-    av_opt_set_int(swr_ctx, "in_sample_rate", src_rate, 0);
-    av_opt_set_sample_fmt(swr_ctx, "in_sample_fmt", src_sample_fmt, 0);
-
-    av_opt_set_int(swr_ctx, "out_channel_layout", dst_ch_layout, 0);
-    av_opt_set_int(swr_ctx, "out_sample_rate", dst_rate, 0);
-    av_opt_set_sample_fmt(swr_ctx, "out_sample_fmt", dst_sample_fmt, 0);
-    swr_init(swr_ctx);
-
-    unsigned char headbuf[44];
-    write_prelim_header(dstFile, headbuf);
-    unsigned int sound_length = 0;
-
-    ret = av_samples_alloc_array_and_samples(&src_data, &src_linesize, src_nb_channels, src_nb_samples, src_sample_fmt, 0);
-    if (ret < 0) {
-        fprintf(stderr, "Could not allocate source samples\n");
-        return -1;
-    }
-
-    src_data[0] = wav_data;
-
-    dst_nb_channels = av_get_channel_layout_nb_channels(dst_ch_layout);
-    dst_nb_samples = av_rescale_rnd(swr_get_delay(swr_ctx, src_rate) + src_nb_samples, dst_rate, src_rate, AV_ROUND_UP);
-    
-    ret = av_samples_alloc_array_and_samples(&dst_data, &dst_linesize, dst_nb_channels, dst_nb_samples, dst_sample_fmt, 0);
-    if (ret < 0) {
-        fprintf(stderr, "Could not allocate destinate samples\n");
+    if (wav_read_format(wavFile, &wavFormat) < 0) {
+        fprintf(stderr, "Could not read wave format from %s\n", filename);
+        fclose(wavFile);
         return -1;
     }
 
-    ret = swr_convert(swr_ctx, dst_data, dst_nb_samples, (const uint8_t**)src_data, src_nb_samples);
-    if (ret < 0) {
-        fprintf(stderr, "Error while converting\n");
-        return -1;
-    }
+    FileWriter writer;
 
-    dst_bufsize = av_samples_get_buffer_size(&dst_linesize, dst_nb_channels, ret, dst_sample_fmt, 1);
-    if (dst_bufsize < 0) {
-        fprintf(stderr, "Could not get sample buffer size\n");
+    if (file_writer_open(&writer, dst_filename, writer_flags) < 0) {
+        fprintf(stderr, "Could not open destination file %s\n", dst_filename);
+        fclose(wavFile);
         return -1;
     }
+    int64_t expected = output_format_data_size(out, wav_duration(&wavFormat));
+    WavHeader header;
+    wav_header_init(&header, out, container, expected);
+    file_writer_preallocate(&writer, expected + header.size);
+
+    OutputSink sink;
+    output_sink_init_writer(&sink, &writer);
+    wav_header_write(&header, &sink, WAV_HEADER_UNKNOWN_SIZE);
+
+    if (mode == INPUT_AUTO)
+        mode = wavFormat.dataSize >= RESAMPLE_MMAP_THRESHOLD ? INPUT_MMAP : INPUT_FREAD;
+
+    int64_t ret;
+    if (threads != 1)
+        ret = resample_wave_parallel(wavFile, &wavFormat, out, &sink, block_frames, threads);
+    else if (mode == INPUT_MMAP)
+        ret = resample_wave_mapped(wavFile, &wavFormat, out, &sink, block_frames);
+    else
+        ret = resample_wave_stream(wavFile, &wavFormat, out, &sink, block_frames);
+    if (ret >= 0)
+        ret = wav_header_finalize(&header, &sink, (uint64_t)ret) == 0 ? ret : -1;
+
+    if (file_writer_close(&writer) < 0)
+        ret = -1;
+    fclose(wavFile);
 
-    sound_length += fwrite(dst_data[0], 1, dst_bufsize, dstFile);
-    
-    rewrite_header(dstFile, headbuf, sound_length);
-
-    fclose(dstFile);
-
-    if (src_data)
-        av_freep(&src_data);    
-
-    if (dst_data)
-        av_freep(&dst_data);
-
-    swr_free(&swr_ctx);
+    return ret < 0 ? -1 : 0;
+}
 
-    return 0;
+static void print_stats(double seconds)
+{
+    size_t peak_rss_kb;
+
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    peak_rss_kb = counters.PeakWorkingSetSize / 1024;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    peak_rss_kb = (size_t)usage.ru_maxrss;
+#endif
+
+    fprintf(stderr, "time: %.3f s, peak RSS: %zu KB\n", seconds, peak_rss_kb);
 }
 
 int main(int argc, char** argv)
 {
-    const char* filename;
+    const char* filename = NULL;
+    const char* rate = NULL;
+    const char* layout = NULL;
+    const char* sample_fmt = NULL;
+    OutputFormat out;
+    int block_frames = RESAMPLE_BLOCK_FRAMES;
+    InputMode mode = INPUT_AUTO;
+    bool stats = false;
+    int threads = 1;
+    int writer_flags = 0;
+    enum WavContainer container = WAV_CONTAINER_AUTO;
+    enum SampleDither dither = SAMPLE_DITHER_NONE;
+    SampleMixMatrix matrix;
+    bool has_matrix = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--block") && i + 1 < argc)
+            block_frames = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--io") && i + 1 < argc) {
+            const char* io = argv[++i];
+            mode = !strcmp(io, "mmap") ? INPUT_MMAP : !strcmp(io, "fread") ? INPUT_FREAD : INPUT_AUTO;
+        }
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--rate") && i + 1 < argc)
+            rate = argv[++i];
+        else if (!strcmp(argv[i], "--layout") && i + 1 < argc)
+            layout = argv[++i];
+        else if (!strcmp(argv[i], "--format") && i + 1 < argc)
+            sample_fmt = argv[++i];
+        else if (!strcmp(argv[i], "--stats"))
+            stats = true;
+        else if (!strcmp(argv[i], "--container") && i + 1 < argc) {
+            if (wav_header_parse_container(argv[++i], &container) < 0)
+                return 1;
+        }
+        else if (!strcmp(argv[i], "--resampler") && i + 1 < argc) {
+            enum ResamplerEngine engine;
+            if (resampler_parse_engine(argv[++i], &engine) < 0)
+                return 1;
+            resampler_set_engine(engine);
+        }
+        else if (!strcmp(argv[i], "--isa") && i + 1 < argc) {
+            enum PolyphaseIsa isa;
+            if (polyphase_parse_isa(argv[++i], &isa) < 0)
+                return 1;
+            polyphase_limit_isa(isa);
+        }
+        else if (!strcmp(argv[i], "--dither") && i + 1 < argc) {
+            if (sample_mix_parse_dither(argv[++i], &dither) < 0)
+                return 1;
+        }
+        else if (!strcmp(argv[i], "--mix") && i + 1 < argc) {
+            if (sample_mix_parse_matrix(argv[++i], &matrix) < 0)
+                return 1;
+            has_matrix = true;
+        }
+        else if (!strcmp(argv[i], "--direct"))
+            writer_flags |= FILE_WRITER_DIRECT;
+        else
+            filename = argv[i];
+    }
 
-    if (argc <= 1)
+    if (!filename || block_frames <= 0)
     {
-        fprintf(stderr, "Usage: %s <input file>\n", argv[0]);
+        fprintf(stderr, "Usage: %s [--block <frames>] [--io auto|fread|mmap] [--threads <n>] [--direct] [--stats] [--container auto|wav|rf64|w64]\n"
+                        "          [--rate <hz>] [--layout <layout>] [--format u8|s16|s32|flt|mulaw|alaw]\n"
+                        "          [--resampler swr|native] [--isa scalar|sse2|avx2|avx512] [--dither none|tpdf|shaped] [--mix <gains>]\n"
+                        "          <input file>\n", argv[0]);
         exit(0);
     }
 
-    filename = argv[1];
+    output_format_init(&out);
+    if (output_format_parse(&out, rate, layout, sample_fmt) < 0)
+        return 1;
+    if (resampler_set_mix(dither, has_matrix ? &matrix : NULL, &out) < 0)
+        return 1;
+
+    int64_t start = av_gettime_relative();
+    int ret = resample_wave(filename, &out, container, block_frames, mode, threads, writer_flags);
 
-    int ret = resample_wave(filename);
+    if (stats)
+        print_stats((av_gettime_relative() - start) / 1000000.0);
 
     return ret;
 }
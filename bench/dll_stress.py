@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+"""Concurrency stress for the ConvertSound library exports.
+
+Loads ConvertSound.dll / libconvertsound.so through ctypes (which releases the
+GIL for the duration of each call), converts every input once on a single
+thread to get reference results, then runs THREADS x ITERATIONS conversions
+through ConvertSound, ConvertSoundBufferToBuffer and ResampleWave at the same
+time and checks that every result is bit-identical to its reference.
+
+For a ThreadSanitizer run build the library with -fsanitize=thread and preload
+the runtime into the interpreter:
+
+    LD_PRELOAD=$(gcc -print-file-name=libtsan.so) \
+        python bench/dll_stress.py --lib build/libconvertsound.so --threads 32
+"""
+
+import argparse
+import ctypes
+import os
+import sys
+import tempfile
+import threading
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+DEFAULT_INPUTS = [
+    os.path.join(HERE, "..", "ConvertSound", "ConvertSound", "ring.mp3"),
+    os.path.join(HERE, "..", "ConvertSound", "ConvertSound", "Testfile.wav"),
+]
+
+
+def load(path):
+    lib = ctypes.CDLL(path)
+    lib.ConvertSound.argtypes = [ctypes.c_char_p, ctypes.c_char_p]
+    lib.ResampleWave.argtypes = [ctypes.c_char_p, ctypes.c_char_p]
+    lib.ConvertSoundBufferToBuffer.argtypes = [
+        ctypes.c_char_p, ctypes.c_size_t,
+        ctypes.POINTER(ctypes.POINTER(ctypes.c_uint8)), ctypes.POINTER(ctypes.c_size_t), ctypes.c_size_t]
+    lib.ConvertSoundFree.argtypes = [ctypes.POINTER(ctypes.c_uint8)]
+    lib.ConvertSoundFree.restype = None
+    return lib
+
+
+def file_op(func):
+    def run(lib, path, data, out):
+        if getattr(lib, func)(path.encode(), out.encode()) < 0:
+            return None
+        with open(out, "rb") as f:
+            return f.read()
+    return run
+
+
+def buffer_op(lib, path, data, out):
+    result = ctypes.POINTER(ctypes.c_uint8)()
+    size = ctypes.c_size_t()
+    if lib.ConvertSoundBufferToBuffer(data, len(data), ctypes.byref(result), ctypes.byref(size), 0) < 0:
+        return None
+    try:
+        return ctypes.string_at(result, size.value)
+    finally:
+        lib.ConvertSoundFree(result)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--lib", required=True, help="ConvertSound.dll or libconvertsound.so")
+    parser.add_argument("--threads", type=int, default=os.cpu_count())
+    parser.add_argument("--iterations", type=int, default=20)
+    parser.add_argument("inputs", nargs="*", default=DEFAULT_INPUTS)
+    args = parser.parse_args()
+
+    lib = load(os.path.abspath(args.lib))
+    ops = [("ConvertSound", file_op("ConvertSound")), ("ConvertSoundBufferToBuffer", buffer_op)]
+    wav_ops = [("ResampleWave", file_op("ResampleWave"))]
+
+    with tempfile.TemporaryDirectory() as work:
+        cases = []
+        for path in args.inputs:
+            with open(path, "rb") as f:
+                data = f.read()
+            for name, op in ops + (wav_ops if path.lower().endswith(".wav") else []):
+                ref = op(lib, path, data, os.path.join(work, "reference.wav"))
+                if ref is None:
+                    sys.exit("%s failed on %s single-threaded" % (name, path))
+                cases.append((name, op, path, data, ref))
+
+        failures = []
+        lock = threading.Lock()
+
+        def worker(index):
+            for i in range(args.iterations):
+                name, op, path, data, ref = cases[(index + i) % len(cases)]
+                out = os.path.join(work, "out_%d_%d.wav" % (index, i))
+                if op(lib, path, data, out) != ref:
+                    with lock:
+                        failures.append("%s on %s (thread %d, iteration %d)" % (name, path, index, i))
+                if os.path.exists(out):
+                    os.remove(out)
+
+        threads = [threading.Thread(target=worker, args=(t,)) for t in range(args.threads)]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+
+    total = args.threads * args.iterations
+    print("%d conversions on %d threads, %d mismatches" % (total, args.threads, len(failures)))
+    for failure in failures:
+        print("  " + failure)
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == "__main__":
+    main()
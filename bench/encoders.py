@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+"""Output size and throughput of ConvertSound per --codec.
+
+Loops the data chunk of a source file into a PCM WAV of the given length and
+converts it with ConvertSound --stats once per codec, keeping the fastest of a
+few runs. Each codec runs at the rate it is meant for (G.722 at 16 kHz, the
+rest at 8 kHz) in mono. The ratio column is the output size against 16-bit PCM
+at the same rate, header included; realtime is audio seconds per second of the
+whole conversion, decode and resampling included, so the pcm row is the cost
+without an encoder.
+
+    python bench/encoders.py --tool ConvertSound/x64/Release/ConvertSound.exe --minutes 30
+"""
+
+import argparse
+import os
+import re
+import subprocess
+import tempfile
+
+from resample_rss import DEFAULT_SOURCE, read_pcm, write_looped
+
+# Name passed to --codec, output rate, output extension.
+CODECS = [
+    ("pcm", 8000, ".wav"),
+    ("flac", 8000, ".flac"),
+    ("adpcm_ima", 8000, ".wav"),
+    ("adpcm_ms", 8000, ".wav"),
+    ("g726", 8000, ".wav"),
+    ("pcm", 16000, ".wav"),
+    ("flac", 16000, ".flac"),
+    ("g722", 16000, ".wav"),
+]
+
+
+def run(tool, codec, rate, src, dst, work):
+    out = subprocess.run([tool, "--stats", "--codec", codec, "--rate", str(rate), "--layout", "mono", src, dst],
+                         cwd=work, capture_output=True, text=True, check=True).stderr
+    return float(re.search(r"total: ([\d.]+) ms", out).group(1)) / 1000.0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--tool", required=True, help="ConvertSound executable")
+    parser.add_argument("--source", default=DEFAULT_SOURCE, help="PCM WAV whose data chunk is looped")
+    parser.add_argument("--minutes", type=float, default=10, help="length of the looped input")
+    parser.add_argument("--repeat", type=int, default=3)
+    args = parser.parse_args()
+
+    tool = os.path.abspath(args.tool)
+    channels, rate, bits, pcm = read_pcm(args.source)
+    seconds = int(args.minutes * 60)
+
+    print("%-10s %6s %14s %8s %10s %10s" % ("codec", "rate", "bytes", "ratio", "time s", "realtime"))
+    with tempfile.TemporaryDirectory() as work:
+        src = os.path.join(work, "input.wav")
+        write_looped(src, seconds, channels, rate, bits, pcm)
+
+        for codec, out_rate, extension in CODECS:
+            dst = os.path.join(work, "output" + extension)
+            best = min(run(tool, codec, out_rate, src, dst, work) for _ in range(args.repeat))
+            size = os.path.getsize(dst)
+            print("%-10s %6d %14d %8.3f %10.3f %10.1f" % (codec, out_rate, size, size / (44 + seconds * out_rate * 2),
+                                                          best, seconds / best))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+"""Hand-built WAV header against the libavformat muxers in ConvertSound.
+
+Loops the data chunk of a source file into a PCM WAV of the given length and
+converts it twice per container: once at the source rate to s32, where the
+conversion is cheap and writing dominates, and once to 8 kHz s16. The wav row
+is the built-in writer (--container wav); the others go through --muxer. The
+fastest of a few runs is kept; overhead is the time against the built-in row
+of the same case. For the muxed WAV the data chunk is compared with the
+built-in one, "same" when the samples are identical.
+
+    python bench/muxer_output.py --tool ConvertSound/x64/Release/ConvertSound.exe --minutes 30
+"""
+
+import argparse
+import os
+import re
+import struct
+import subprocess
+import tempfile
+
+from resample_rss import DEFAULT_SOURCE, read_pcm, write_looped
+
+# Row name, options, output extension.
+OUTPUTS = [
+    ("wav", ["--container", "wav"], ".wav"),
+    ("lavf wav", ["--muxer", "wav"], ".wav"),
+    ("au", ["--muxer", "au"], ".au"),
+    ("caf", ["--muxer", "caf"], ".caf"),
+    ("raw", ["--muxer", "raw"], ".raw"),
+    ("mkv", ["--muxer", "mkv"], ".mka"),
+]
+
+
+def run(tool, args, src, dst, work):
+    out = subprocess.run([tool, "--stats"] + args + [src, dst], cwd=work,
+                         capture_output=True, text=True, check=True).stderr
+    return float(re.search(r"total: ([\d.]+) ms", out).group(1)) / 1000.0
+
+
+def wav_data(path):
+    """Payload of the data chunk of a RIFF WAV."""
+    with open(path, "rb") as f:
+        f.seek(12)
+        while True:
+            head = f.read(8)
+            if len(head) < 8:
+                return None
+            tag, size = struct.unpack("<4sI", head)
+            if tag == b"data":
+                return f.read(size)
+            f.seek(size + (size & 1), os.SEEK_CUR)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--tool", required=True, help="ConvertSound executable")
+    parser.add_argument("--source", default=DEFAULT_SOURCE, help="PCM WAV whose data chunk is looped")
+    parser.add_argument("--minutes", type=float, default=10, help="length of the looped input")
+    parser.add_argument("--repeat", type=int, default=3)
+    args = parser.parse_args()
+
+    tool = os.path.abspath(args.tool)
+    channels, rate, bits, pcm = read_pcm(args.source)
+    seconds = int(args.minutes * 60)
+    cases = [(rate, "s32"), (8000, "s16")]
+
+    print("%6s %4s %-9s %14s %10s %8s %9s %5s" % ("rate", "fmt", "output", "bytes", "time s", "GB/s", "overhead",
+                                                  "data"))
+    with tempfile.TemporaryDirectory() as work:
+        src = os.path.join(work, "input.wav")
+        write_looped(src, seconds, channels, rate, bits, pcm)
+
+        for out_rate, fmt in cases:
+            extra = ["--rate", str(out_rate), "--format", fmt]
+            base_time = base_data = None
+            for name, options, extension in OUTPUTS:
+                dst = os.path.join(work, "output" + extension)
+                best = min(run(tool, extra + options, src, dst, work) for _ in range(args.repeat))
+                size = os.path.getsize(dst)
+
+                same = ""
+                if name == "wav":
+                    base_time, base_data = best, wav_data(dst)
+                elif extension == ".wav":
+                    same = "same" if wav_data(dst) == base_data else "DIFF"
+
+                print("%6d %4s %-9s %14d %10.3f %8.2f %8.1f%% %5s" % (out_rate, fmt, name, size, best,
+                                                                      size / best / 1e9,
+                                                                      100.0 * (best / base_time - 1), same))
+
+
+if __name__ == "__main__":
+    main()
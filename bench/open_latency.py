@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+"""ConvertSound open latency with and without --fast, per input format.
+
+Runs ConvertSound --stats on every input, once with the default probing and
+once with --fast, and reports the time spent opening the input (demuxer probe
+plus stream info) and the whole conversion, averaged per container format.
+Every run is repeated and the fastest is kept, so both modes see a warm page
+cache.
+
+    python bench/open_latency.py --tool ConvertSound/x64/Release/ConvertSound.exe samples/*.mp3 samples/*.m4a
+"""
+
+import argparse
+import os
+import re
+import subprocess
+import tempfile
+from collections import defaultdict
+
+STATS = re.compile(r"format (\S+), open: ([\d.]+) ms, total: ([\d.]+) ms")
+
+
+def run(tool, flags, src, work):
+    out = subprocess.run([tool, "--stats"] + flags + [src], cwd=work,
+                         capture_output=True, text=True, check=True).stderr
+    m = STATS.search(out)
+    # WAVs already in the output format are copied and never opened.
+    if not m:
+        return None
+    return m.group(1), float(m.group(2)), float(m.group(3))
+
+
+def best(tool, flags, src, work, repeat):
+    runs = [run(tool, flags, src, work) for _ in range(repeat)]
+    if None in runs:
+        return None
+    return runs[0][0], min(r[1] for r in runs), min(r[2] for r in runs)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--tool", required=True, help="ConvertSound executable")
+    parser.add_argument("--repeat", type=int, default=3)
+    parser.add_argument("inputs", nargs="+", help="encoded audio files")
+    args = parser.parse_args()
+
+    tool = os.path.abspath(args.tool)
+    results = defaultdict(list)
+
+    with tempfile.TemporaryDirectory() as work:
+        for src in (os.path.abspath(p) for p in args.inputs):
+            default = best(tool, [], src, work, args.repeat)
+            fast = best(tool, ["--fast"], src, work, args.repeat)
+            if default and fast:
+                results[default[0]].append((default[1], fast[1], default[2], fast[2]))
+
+    print("%-12s %6s %12s %12s %10s %12s %12s" % ("format", "files", "open ms", "fast open ms", "saved ms",
+                                                 "total ms", "fast total"))
+    for name, rows in sorted(results.items()):
+        n = len(rows)
+        mean = [sum(r[i] for r in rows) / n for i in range(4)]
+        print("%-12s %6d %12.2f %12.2f %10.2f %12.2f %12.2f" % (name, n, mean[0], mean[1], mean[0] - mean[1],
+                                                               mean[2], mean[3]))
+
+
+if __name__ == "__main__":
+    main()
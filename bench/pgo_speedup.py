@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+"""Speedup of a profile-guided build over a plain one, end to end.
+
+Takes two CMake build directories, by default build (plain LTO) and build-pgo
+(LTO with CONVERT_SOUND_PGO=USE), and times the same conversions with the
+ConvertSound and ResampleWave of each: the source WAV looped to the given
+length through ResampleWave (swr and native) and ConvertSound (native, and
+FLAC output), and ring.mp3 through ConvertSound. Runs alternate between the
+builds and the fastest of each is kept.
+
+    cmake -S . -B build -DCMAKE_BUILD_TYPE=Release && cmake --build build -j
+    cmake -S . -B build-pgo -DCMAKE_BUILD_TYPE=Release -DCONVERT_SOUND_PGO=GENERATE
+    cmake --build build-pgo -j && cmake --build build-pgo --target pgo-train
+    cmake -S . -B build-pgo -DCONVERT_SOUND_PGO=USE && cmake --build build-pgo -j
+    python bench/pgo_speedup.py --plain build --pgo build-pgo --minutes 10
+"""
+
+import argparse
+import os
+import re
+import subprocess
+import tempfile
+
+from resample_rss import HERE, read_pcm, write_looped
+
+SOURCE = os.path.join(HERE, "..", "ConvertSound", "ConvertSound", "Testfile.wav")
+RING = os.path.join(HERE, "..", "ConvertSound", "ConvertSound", "ring.mp3")
+
+# Row name, tool, options, input ("looped" or "ring").
+CASES = [
+    ("ResampleWave swr", "ResampleWave", ["--resampler", "swr"], "looped"),
+    ("ResampleWave native", "ResampleWave", ["--resampler", "native", "--dither", "tpdf"], "looped"),
+    ("ConvertSound native", "ConvertSound", ["--resampler", "native"], "looped"),
+    ("ConvertSound flac", "ConvertSound", ["--codec", "flac"], "looped"),
+    ("ConvertSound mp3", "ConvertSound", [], "ring"),
+]
+
+
+def run(tool, options, src, work):
+    # ResampleWave writes result.wav in the working directory, ConvertSound
+    # takes the output name.
+    args = [tool, "--stats"] + options + [src]
+    if os.path.basename(tool).startswith("ConvertSound"):
+        args.append("out" + (".flac" if "flac" in options else ".wav"))
+    out = subprocess.run(args, cwd=work, capture_output=True, text=True, check=True).stderr
+    m = re.search(r"time: ([\d.]+) s", out)
+    if m:
+        return float(m.group(1))
+    return float(re.search(r"total: ([\d.]+) ms", out).group(1)) / 1000.0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--plain", default="build", help="build directory without PGO")
+    parser.add_argument("--pgo", default="build-pgo", help="build directory with CONVERT_SOUND_PGO=USE")
+    parser.add_argument("--source", default=SOURCE, help="PCM WAV whose data chunk is looped")
+    parser.add_argument("--minutes", type=float, default=10, help="length of the looped input")
+    parser.add_argument("--repeat", type=int, default=5)
+    args = parser.parse_args()
+
+    builds = [os.path.abspath(args.plain), os.path.abspath(args.pgo)]
+    channels, rate, bits, pcm = read_pcm(args.source)
+    seconds = int(args.minutes * 60)
+
+    print("%-22s %10s %10s %8s" % ("case", "plain s", "pgo s", "speedup"))
+    with tempfile.TemporaryDirectory() as work:
+        looped = os.path.join(work, "input.wav")
+        write_looped(looped, seconds, channels, rate, bits, pcm)
+        inputs = {"looped": looped, "ring": os.path.abspath(RING)}
+
+        total = [0.0, 0.0]
+        for name, tool, options, source in CASES:
+            best = [float("inf"), float("inf")]
+            for _ in range(args.repeat):
+                for i, build in enumerate(builds):
+                    best[i] = min(best[i], run(os.path.join(build, tool), options, inputs[source], work))
+            total = [total[0] + best[0], total[1] + best[1]]
+            print("%-22s %10.3f %10.3f %7.1f%%" % (name, best[0], best[1], 100.0 * (best[0] / best[1] - 1)))
+        print("%-22s %10.3f %10.3f %7.1f%%" % ("total", total[0], total[1], 100.0 * (total[0] / total[1] - 1)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,52 @@
+#!/usr/bin/env python3
+"""ResampleWave fread path against the mmap path on multi-GB inputs.
+
+Builds looped PCM WAV inputs of the given sizes and runs ResampleWave --stats
+with --io fread and --io mmap on each. Every run is repeated and the fastest is
+kept, so both modes are measured with a warm page cache.
+
+    python bench/resample_mmap.py --tool ResampleWave/x64/Release/ResampleWave.exe --gb 1,2,4
+"""
+
+import argparse
+import os
+import re
+import subprocess
+import tempfile
+
+from resample_rss import DEFAULT_SOURCE, read_pcm, write_looped
+
+
+def run(tool, mode, src, work):
+    out = subprocess.run([tool, "--io", mode, "--stats", src], cwd=work,
+                         capture_output=True, text=True, check=True).stderr
+    m = re.search(r"time: ([\d.]+) s, peak RSS: (\d+) KB", out)
+    return float(m.group(1)), int(m.group(2))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--tool", required=True, help="ResampleWave executable")
+    parser.add_argument("--source", default=DEFAULT_SOURCE, help="PCM WAV whose samples are looped")
+    parser.add_argument("--gb", default="1,2,4", help="comma separated input sizes in GB (below 4 for RIFF)")
+    parser.add_argument("--repeat", type=int, default=3)
+    args = parser.parse_args()
+
+    tool = os.path.abspath(args.tool)
+    channels, rate, bits, pcm = read_pcm(args.source)
+    bytes_per_second = channels * rate * bits // 8
+
+    print("%6s %8s %10s %14s %10s" % ("GB", "io", "time s", "peak RSS KB", "MB/s"))
+    with tempfile.TemporaryDirectory() as work:
+        for gb in (float(g) for g in args.gb.split(",")):
+            src = os.path.join(work, "input.wav")
+            write_looped(src, int(gb * 1e9 / bytes_per_second), channels, rate, bits, pcm)
+            size_mb = os.path.getsize(src) / 1e6
+            for mode in ("fread", "mmap"):
+                best = min(run(tool, mode, src, work) for _ in range(args.repeat))
+                print("%6.1f %8s %10.3f %14d %10.0f" % (gb, mode, best[0], best[1], size_mb / best[0]))
+            os.remove(src)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+"""Native polyphase resampler against swresample: speed per kernel set and SNR.
+
+Takes the bundled 44.1 kHz test files, derives 48 kHz and 16 kHz copies of
+them with ResampleWave's swr engine and loops every input to the given length.
+Each input is then converted to 8 kHz mono s16 with --resampler swr and with
+--resampler native under each --isa cap. The table lists the fastest time of
+a few runs, throughput in audio seconds per second and the SNR of the native
+output taken against swr's (both engines are flat up to 3.4 kHz, so the figure
+mostly shows where their stopbands and transition bands differ).
+
+    python bench/resample_native.py --tool ResampleWave/x64/Release/ResampleWave.exe
+"""
+
+import argparse
+import math
+import os
+import re
+import shutil
+import subprocess
+import tempfile
+
+from resample_rss import HERE, read_pcm, write_looped
+from resample_threads import read_data
+
+SOURCES = [
+    os.path.join(HERE, "..", "ResampleWave", "ResampleWave", "Test.wav"),
+    os.path.join(HERE, "..", "ConvertSound", "ConvertSound", "Testfile.wav"),
+]
+
+
+def run(tool, args, src, work):
+    out = subprocess.run([tool, "--stats"] + args + [src], cwd=work,
+                         capture_output=True, text=True, check=True).stderr
+    return float(re.search(r"time: ([\d.]+) s", out).group(1))
+
+
+def convert(tool, args, src, work, dst):
+    run(tool, args, src, work)
+    shutil.move(os.path.join(work, "result.wav"), dst)
+
+
+def snr(reference, test):
+    """SNR of test against reference in dB, over the common length minus the edges."""
+    n = min(len(reference), len(test))
+    signal = noise = 0
+    for x, y in zip(reference[100:n - 100], test[100:n - 100]):
+        signal += x * x
+        noise += (x - y) * (x - y)
+    return float("inf") if noise == 0 else 10 * math.log10(signal / noise)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--tool", required=True, help="ResampleWave executable")
+    parser.add_argument("--minutes", type=float, default=10, help="length each input is looped to")
+    parser.add_argument("--isa", default="scalar,sse2,avx2,avx512", help="comma separated kernel sets")
+    parser.add_argument("--repeat", type=int, default=3)
+    args = parser.parse_args()
+
+    tool = os.path.abspath(args.tool)
+    seconds = int(args.minutes * 60)
+    to_8k = ["--rate", "8000", "--layout", "mono", "--format", "s16"]
+
+    print("%-14s %6s %8s %10s %12s %10s" % ("input", "rate", "engine", "time s", "audio s/s", "SNR dB"))
+    with tempfile.TemporaryDirectory() as work:
+        for source in SOURCES:
+            name = os.path.basename(source)
+            inputs = [(44100, os.path.abspath(source))]
+            for rate in (48000, 16000):
+                derived = os.path.join(work, "%d_%s" % (rate, name))
+                convert(tool, ["--resampler", "swr", "--rate", str(rate)], inputs[0][1], work, derived)
+                inputs.append((rate, derived))
+
+            for rate, path in inputs:
+                looped = os.path.join(work, "looped.wav")
+                write_looped(looped, seconds, *read_pcm(path))
+
+                best = min(run(tool, ["--resampler", "swr"] + to_8k, looped, work) for _ in range(args.repeat))
+                reference = read_data(os.path.join(work, "result.wav"), "h")
+                print("%-14s %6d %8s %10.3f %12.0f %10s" % (name, rate, "swr", best, seconds / best, "-"))
+
+                for isa in args.isa.split(","):
+                    engine = ["--resampler", "native", "--isa", isa]
+                    best = min(run(tool, engine + to_8k, looped, work) for _ in range(args.repeat))
+                    native = read_data(os.path.join(work, "result.wav"), "h")
+                    print("%-14s %6d %8s %10.3f %12.0f %10.1f" % (name, rate, isa, best, seconds / best,
+                                                                  snr(reference, native)))
+                os.remove(looped)
+
+
+if __name__ == "__main__":
+    main()
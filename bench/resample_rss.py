@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+"""Peak RSS of ResampleWave against input length.
+
+Builds PCM WAV inputs of increasing duration by looping the data chunk of a
+source file, runs ResampleWave --stats on each and prints the reported time and
+peak RSS. With streaming resampling the RSS column should stay flat.
+
+    python bench/resample_rss.py --tool ResampleWave/x64/Release/ResampleWave.exe
+"""
+
+import argparse
+import os
+import re
+import struct
+import subprocess
+import tempfile
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+DEFAULT_SOURCE = os.path.join(HERE, "..", "ResampleWave", "ResampleWave", "Test.wav")
+
+
+def read_pcm(path):
+    with open(path, "rb") as f:
+        head = f.read(44)
+        channels, rate = struct.unpack_from("<HI", head, 22)
+        bits = struct.unpack_from("<H", head, 34)[0]
+        size = struct.unpack_from("<I", head, 40)[0]
+        return channels, rate, bits, f.read(size)
+
+
+def write_looped(path, seconds, channels, rate, bits, pcm):
+    block_align = channels * bits // 8
+    total = seconds * rate * block_align
+    with open(path, "wb") as f:
+        f.write(b"RIFF" + struct.pack("<I", 36 + total) + b"WAVE")
+        f.write(b"fmt " + struct.pack("<IHHIIHH", 16, 1, channels, rate, rate * block_align, block_align, bits))
+        f.write(b"data" + struct.pack("<I", total))
+        left = total
+        while left > 0:
+            chunk = pcm[:left]
+            f.write(chunk)
+            left -= len(chunk)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--tool", required=True, help="ResampleWave executable")
+    parser.add_argument("--source", default=DEFAULT_SOURCE, help="PCM WAV whose samples are looped")
+    parser.add_argument("--minutes", default="1,10,60,600", help="comma separated input durations")
+    parser.add_argument("--block", type=int, help="frames per block passed to --block")
+    args = parser.parse_args()
+
+    tool = os.path.abspath(args.tool)
+    channels, rate, bits, pcm = read_pcm(args.source)
+
+    print("%10s %12s %10s %14s" % ("minutes", "input MB", "time s", "peak RSS KB"))
+    with tempfile.TemporaryDirectory() as work:
+        for minutes in (int(m) for m in args.minutes.split(",")):
+            src = os.path.join(work, "input.wav")
+            write_looped(src, minutes * 60, channels, rate, bits, pcm)
+            cmd = [tool, "--stats", src]
+            if args.block:
+                cmd[1:1] = ["--block", str(args.block)]
+            out = subprocess.run(cmd, cwd=work, capture_output=True, text=True, check=True).stderr
+            m = re.search(r"time: ([\d.]+) s, peak RSS: (\d+) KB", out)
+            print("%10d %12.1f %10s %14s" % (minutes, os.path.getsize(src) / 1e6, m.group(1), m.group(2)))
+            os.remove(src)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+"""ResampleWave throughput against --threads on hours-long inputs.
+
+Loops the data chunk of a source file into a PCM WAV of the given length, runs
+ResampleWave --threads n --stats for each thread count and prints the fastest
+time of a few runs with the resulting throughput in audio seconds per second.
+Every output is compared sample by sample against the single-threaded one; the
+diff column is the largest difference, 0 when the outputs are bit-exact.
+
+    python bench/resample_threads.py --tool ResampleWave/x64/Release/ResampleWave.exe --hours 4
+"""
+
+import argparse
+import array
+import os
+import re
+import subprocess
+import tempfile
+
+from resample_rss import DEFAULT_SOURCE, read_pcm, write_looped
+
+FORMAT_TYPECODES = {"u8": "B", "s16": "h", "s32": "i", "flt": "f"}
+
+
+def run(tool, threads, src, work, extra):
+    out = subprocess.run([tool, "--threads", str(threads), "--stats"] + extra + [src], cwd=work,
+                         capture_output=True, text=True, check=True).stderr
+    return float(re.search(r"time: ([\d.]+) s", out).group(1))
+
+
+def read_data(path, typecode):
+    """Samples of the data chunk, skipping whatever chunks come before it."""
+    with open(path, "rb") as f:
+        f.seek(12)
+        while True:
+            head = f.read(8)
+            if len(head) < 8:
+                raise ValueError("%s has no data chunk" % path)
+            size = int.from_bytes(head[4:], "little")
+            if head[:4] == b"data":
+                samples = array.array(typecode)
+                samples.frombytes(f.read() if size == 0xFFFFFFFF else f.read(size))
+                return samples
+            f.seek(size + (size & 1), os.SEEK_CUR)
+
+
+def max_diff(a, b):
+    if len(a) != len(b):
+        return "len %+d" % (len(b) - len(a))
+    return "%g" % max((abs(x - y) for x, y in zip(a, b)), default=0)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--tool", required=True, help="ResampleWave executable")
+    parser.add_argument("--source", default=DEFAULT_SOURCE, help="PCM WAV whose samples are looped")
+    parser.add_argument("--hours", type=float, default=2)
+    parser.add_argument("--threads", default="1,2,4,8,16", help="comma separated thread counts")
+    parser.add_argument("--rate", help="output rate passed to --rate")
+    parser.add_argument("--format", default="s16", choices=sorted(FORMAT_TYPECODES), help="output sample format")
+    parser.add_argument("--repeat", type=int, default=3)
+    args = parser.parse_args()
+
+    tool = os.path.abspath(args.tool)
+    channels, rate, bits, pcm = read_pcm(args.source)
+    seconds = int(args.hours * 3600)
+    extra = ["--format", args.format] + (["--rate", args.rate] if args.rate else [])
+    typecode = FORMAT_TYPECODES[args.format]
+
+    print("%8s %10s %12s %10s %10s" % ("threads", "time s", "audio s/s", "speedup", "diff"))
+    with tempfile.TemporaryDirectory() as work:
+        src = os.path.join(work, "input.wav")
+        write_looped(src, seconds, channels, rate, bits, pcm)
+        result = os.path.join(work, "result.wav")
+
+        reference = None
+        base = None
+        for threads in (int(t) for t in args.threads.split(",")):
+            best = min(run(tool, threads, src, work, extra) for _ in range(args.repeat))
+            samples = read_data(result, typecode)
+            if reference is None:
+                reference, base = samples, best
+            print("%8d %10.3f %12.0f %10.2f %10s" % (threads, best, seconds / best, base / best,
+                                                      max_diff(reference, samples)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,141 @@
+#!/usr/bin/env python3
+"""Throughput of the fused downmix, s16 conversion and dither in GB/s per input format.
+
+Builds stereo WAV inputs in u8, s16, s32 and float from the samples of a source
+file (the right channel is the left one scaled by 0.8 and delayed by 37 frames,
+so the downmix is not trivial), then converts each to mono s16 at the input
+rate with ResampleWave: once through swr, and once through the native mixer per
+dither mode. A same-rate conversion is the mixer alone, so the figures show its
+cost together with reading and writing the files; GB/s counts the input data
+chunk. The last rows repeat the float input at 8 kHz, where the mixer runs
+after the polyphase filter.
+
+A last check feeds a float sine at +12 dBFS followed by silence through the
+shaped dither and counts the silent output samples further than 4 LSB from
+zero. TPDF noise and the fed back rounding error stay below that, so anything
+above 0 means clipping overshoot leaked into the error feedback.
+
+    python bench/sample_mix.py --tool ResampleWave/x64/Release/ResampleWave.exe
+"""
+
+import argparse
+import array
+import math
+import os
+import re
+import struct
+import subprocess
+import tempfile
+
+from resample_rss import DEFAULT_SOURCE, read_pcm
+
+# Sample format: (WAV format tag, bits, array typecode, scale of a full-scale float).
+FORMATS = {
+    "u8": (1, 8, "B", 127),
+    "s16": (1, 16, "h", 32767),
+    "s32": (1, 32, "i", 2147483647),
+    "flt": (3, 32, "f", 1.0),
+}
+
+
+def to_float(bits, pcm):
+    """Samples of an 8 or 16-bit PCM data chunk as floats in [-1, 1)."""
+    samples = array.array("h" if bits == 16 else "B", pcm)
+    if bits == 8:
+        return [(s - 128) / 128.0 for s in samples]
+    return [s / 32768.0 for s in samples]
+
+
+def write_stereo(path, seconds, rate, mono, fmt):
+    tag, bits, typecode, scale = FORMATS[fmt]
+    stereo = array.array(typecode)
+    for i, s in enumerate(mono):
+        for v in (s, 0.8 * mono[i - 37]):
+            v = v * scale
+            stereo.append(int(v) + 128 if fmt == "u8" else v if fmt == "flt" else int(v))
+    pcm = stereo.tobytes()
+
+    block_align = 2 * bits // 8
+    total = seconds * rate * block_align
+    with open(path, "wb") as f:
+        f.write(b"RIFF" + struct.pack("<I", 36 + total) + b"WAVE")
+        f.write(b"fmt " + struct.pack("<IHHIIHH", 16, tag, 2, rate, rate * block_align, block_align, bits))
+        f.write(b"data" + struct.pack("<I", total))
+        left = total
+        while left > 0:
+            chunk = pcm[:left]
+            f.write(chunk)
+            left -= len(chunk)
+    return total
+
+
+def write_hot(path, rate):
+    """Mono float WAV: half a second of a 1 kHz sine at amplitude 4, then half a second of silence."""
+    half = rate // 2
+    samples = array.array("f", [4.0 * math.sin(2 * math.pi * 1000 * i / rate) for i in range(half)] + [0.0] * half)
+    pcm = samples.tobytes()
+    with open(path, "wb") as f:
+        f.write(b"RIFF" + struct.pack("<I", 36 + len(pcm)) + b"WAVE")
+        f.write(b"fmt " + struct.pack("<IHHIIHH", 16, 3, 1, rate, rate * 4, 4, 32))
+        f.write(b"data" + struct.pack("<I", len(pcm)))
+        f.write(pcm)
+    return half
+
+
+def read_s16(path):
+    """Samples of the data chunk of an s16 WAV."""
+    with open(path, "rb") as f:
+        f.seek(12)
+        while True:
+            tag, size = struct.unpack("<4sI", f.read(8))
+            if tag == b"data":
+                return array.array("h", f.read(size))
+            f.seek(size + (size & 1), os.SEEK_CUR)
+
+
+def run(tool, args, src, work):
+    out = subprocess.run([tool, "--stats"] + args + [src], cwd=work,
+                         capture_output=True, text=True, check=True).stderr
+    return float(re.search(r"time: ([\d.]+) s", out).group(1))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--tool", required=True, help="ResampleWave executable")
+    parser.add_argument("--source", default=DEFAULT_SOURCE, help="PCM WAV whose first channel is used")
+    parser.add_argument("--minutes", type=float, default=10, help="length each input is looped to")
+    parser.add_argument("--isa", help="kernel cap passed to --isa")
+    parser.add_argument("--repeat", type=int, default=3)
+    args = parser.parse_args()
+
+    tool = os.path.abspath(args.tool)
+    channels, rate, bits, pcm = read_pcm(args.source)
+    mono = to_float(bits, pcm)[::channels]
+    seconds = int(args.minutes * 60)
+    isa = ["--isa", args.isa] if args.isa else []
+
+    engines = [("swr", ["--resampler", "swr"])]
+    for dither in ("none", "tpdf", "shaped"):
+        engines.append((dither, ["--resampler", "native", "--dither", dither] + isa))
+
+    print("%-6s %6s %8s %10s %8s" % ("input", "rate", "engine", "time s", "GB/s"))
+    with tempfile.TemporaryDirectory() as work:
+        src = os.path.join(work, "input.wav")
+        cases = [(fmt, rate) for fmt in FORMATS] + [("flt", 8000)]
+        for fmt, out_rate in cases:
+            size = write_stereo(src, seconds, rate, mono, fmt)
+            for name, engine in engines:
+                extra = engine + ["--rate", str(out_rate), "--layout", "mono", "--format", "s16"]
+                best = min(run(tool, extra, src, work) for _ in range(args.repeat))
+                print("%-6s %6d %8s %10.3f %8.2f" % (fmt, out_rate, name, best, size / best / 1e9))
+
+        half = write_hot(src, rate)
+        subprocess.run([tool, "--resampler", "native", "--dither", "shaped", "--rate", str(rate), "--layout", "mono",
+                        "--format", "s16"] + isa + [src], cwd=work, capture_output=True, check=True)
+        out = read_s16(os.path.join(work, "result.wav"))
+        stuck = sum(1 for v in out[half:] if abs(v) > 4)
+        print("shaped dither after +12 dBFS: %d silent samples above 4 LSB (%s)" % (stuck, "ok" if stuck == 0 else "FAIL"))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+"""Process startup of the shared-FFmpeg build against the static trimmed one.
+
+Takes two CMake build directories, by default build (system FFmpeg through
+pkg-config) and build-static (CONVERT_SOUND_STATIC_FFMPEG=ON), and runs the
+ConvertSound of each on the bundled Testfile.wav and ring.mp3 with the output
+on stdout. Two times are taken from just before the process is started: to
+the first byte on the pipe, which covers exec, dynamic loading, relocation and
+FFmpeg initialisation up to the first decoded frame, and to process exit.
+Runs alternate between the builds; the minimum and median of each are shown.
+
+    cmake -S . -B build -DCMAKE_BUILD_TYPE=Release && cmake --build build -j
+    cmake -S . -B build-static -DCMAKE_BUILD_TYPE=Release -DCONVERT_SOUND_STATIC_FFMPEG=ON
+    cmake --build build-static -j
+    python bench/startup_latency.py --dynamic build --static build-static --repeat 50
+"""
+
+import argparse
+import os
+import statistics
+import subprocess
+import time
+
+from resample_rss import HERE
+
+TESTFILE = os.path.join(HERE, "..", "ConvertSound", "ConvertSound", "Testfile.wav")
+RING = os.path.join(HERE, "..", "ConvertSound", "ConvertSound", "ring.mp3")
+
+
+def run(tool, src):
+    """Milliseconds to the first output byte and to exit."""
+    start = time.perf_counter()
+    proc = subprocess.Popen([tool, src, "-"], stdout=subprocess.PIPE, stderr=subprocess.DEVNULL)
+    if not proc.stdout.read(1):
+        raise RuntimeError("%s %s wrote nothing" % (tool, src))
+    first = time.perf_counter()
+    while proc.stdout.read(65536):
+        pass
+    if proc.wait():
+        raise RuntimeError("%s %s failed" % (tool, src))
+    end = time.perf_counter()
+    return (first - start) * 1000.0, (end - start) * 1000.0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--dynamic", default="build", help="build directory linked to the system FFmpeg")
+    parser.add_argument("--static", default="build-static", help="build directory with CONVERT_SOUND_STATIC_FFMPEG=ON")
+    parser.add_argument("--repeat", type=int, default=30)
+    args = parser.parse_args()
+
+    tools = [os.path.join(os.path.abspath(build), "ConvertSound") for build in (args.dynamic, args.static)]
+    inputs = [("Testfile.wav", os.path.abspath(TESTFILE)), ("ring.mp3", os.path.abspath(RING))]
+
+    print("%-13s %-7s %9s %9s %9s %9s" % ("input", "build", "first min", "first med", "exit min", "exit med"))
+    for name, src in inputs:
+        for tool in tools:
+            run(tool, src)  # page cache
+        times = [[], []]
+        for _ in range(args.repeat):
+            for i, tool in enumerate(tools):
+                times[i].append(run(tool, src))
+        first = [[t[0] for t in build] for build in times]
+        end = [[t[1] for t in build] for build in times]
+        for i, label in enumerate(("dynamic", "static")):
+            print("%-13s %-7s %9.2f %9.2f %9.2f %9.2f" % (name, label, min(first[i]), statistics.median(first[i]),
+                                                          min(end[i]), statistics.median(end[i])))
+        print("%-13s %-7s %8.2fx %8.2fx %8.2fx %8.2fx" % (name, "ratio",
+                                                          min(first[0]) / min(first[1]),
+                                                          statistics.median(first[0]) / statistics.median(first[1]),
+                                                          min(end[0]) / min(end[1]),
+                                                          statistics.median(end[0]) / statistics.median(end[1])))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,72 @@
+# StaticFFmpeg.cmake : Trimmed static FFmpeg for CONVERT_SOUND_STATIC_FFMPEG.
+#
+# Builds libavformat, libavcodec, libswresample and libavutil from source with
+# only the components below and no external libraries, and defines the
+# convertsound_ffmpeg interface target that links them in. Nothing is loaded
+# at run time beyond libc and libstdc++, and the libraries hold only the
+# demuxers, decoders, encoders and muxers the tools can reach.
+
+include(ExternalProject)
+
+# Extracted sources get the extraction time, so a new archive rebuilds.
+if(POLICY CMP0135)
+    cmake_policy(SET CMP0135 NEW)
+endif()
+
+set(CONVERT_SOUND_FFMPEG_SOURCE "https://ffmpeg.org/releases/ffmpeg-4.4.4.tar.xz"
+    CACHE STRING "FFmpeg 4.4 source: archive URL, local archive or unpacked directory")
+
+set(CONVERT_SOUND_FFMPEG_DEMUXERS "wav;w64;mp3;mov;aac;flac;ogg;matroska"
+    CACHE STRING "Input formats of the trimmed FFmpeg")
+set(CONVERT_SOUND_FFMPEG_DECODERS
+    "pcm_u8;pcm_s16le;pcm_s16be;pcm_s24le;pcm_s32le;pcm_f32le;pcm_f64le;pcm_mulaw;pcm_alaw;adpcm_ima_wav;adpcm_ms;mp3float;mp3;aac;alac;flac;vorbis;opus"
+    CACHE STRING "Audio decoders of the trimmed FFmpeg")
+set(CONVERT_SOUND_FFMPEG_PARSERS "mpegaudio;aac;flac;vorbis;opus"
+    CACHE STRING "Parsers of the trimmed FFmpeg")
+
+# What --codec and --muxer can ask for.
+set(ffmpeg_encoders flac adpcm_ima_wav adpcm_ms adpcm_g722 adpcm_g726)
+set(ffmpeg_muxers wav flac au caf matroska s16le u8 s32le f32le mulaw alaw g722 g726)
+
+set(ffmpeg_args
+    --disable-everything --disable-autodetect --disable-programs --disable-doc
+    --disable-debug --disable-network
+    --disable-avdevice --disable-avfilter --disable-swscale --disable-postproc
+    --enable-static --disable-shared --enable-pic
+    --enable-protocol=file,pipe)
+foreach(kind demuxer decoder parser)
+    string(TOUPPER "${kind}S" list)
+    string(REPLACE ";" "," components "${CONVERT_SOUND_FFMPEG_${list}}")
+    list(APPEND ffmpeg_args --enable-${kind}=${components})
+endforeach()
+string(REPLACE ";" "," components "${ffmpeg_encoders}")
+list(APPEND ffmpeg_args --enable-encoder=${components})
+string(REPLACE ";" "," components "${ffmpeg_muxers}")
+list(APPEND ffmpeg_args --enable-muxer=${components})
+
+# The x86 decoder kernels need nasm; without it the build is plain C.
+find_program(NASM_EXECUTABLE nasm)
+if(NOT NASM_EXECUTABLE)
+    message(WARNING "nasm not found, the static FFmpeg is built without x86 assembly")
+    list(APPEND ffmpeg_args --disable-x86asm)
+endif()
+
+set(ffmpeg_prefix "${CMAKE_BINARY_DIR}/ffmpeg")
+set(ffmpeg_libs
+    "${ffmpeg_prefix}/lib/libavformat.a"
+    "${ffmpeg_prefix}/lib/libavcodec.a"
+    "${ffmpeg_prefix}/lib/libswresample.a"
+    "${ffmpeg_prefix}/lib/libavutil.a")
+
+ExternalProject_Add(ffmpeg_static
+    URL "${CONVERT_SOUND_FFMPEG_SOURCE}"
+    INSTALL_DIR "${ffmpeg_prefix}"
+    CONFIGURE_COMMAND <SOURCE_DIR>/configure --prefix=<INSTALL_DIR> ${ffmpeg_args}
+    BUILD_BYPRODUCTS ${ffmpeg_libs})
+
+# Imported include paths have to exist when the build system is generated.
+file(MAKE_DIRECTORY "${ffmpeg_prefix}/include")
+
+add_library(convertsound_ffmpeg INTERFACE)
+target_include_directories(convertsound_ffmpeg INTERFACE "${ffmpeg_prefix}/include")
+target_link_libraries(convertsound_ffmpeg INTERFACE ${ffmpeg_libs} m Threads::Threads)